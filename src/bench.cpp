@@ -0,0 +1,256 @@
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "blockRegistry.hpp"
+#include "movementHandler.hpp"
+#include "output.hpp"
+#include "simulation.hpp"
+#include "levelPack.hpp"
+#include "gameLoop.hpp"
+#include "history.hpp"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+/**
+ * Stream buffer that throws away everything written to it.
+ * Used to render frames without the cost of an actual terminal.
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+};
+
+/**
+ * Presses the given keys as fast as the game loop takes them, followed by the end of the input.
+ */
+class ScriptedKeys : public KeySource {
+public:
+    ScriptedKeys(const string& keys) : keys(keys) {}
+
+    bool poll(InputEvent& event) override {
+        if (taken > keys.size()) return false;
+        event.key = taken < keys.size() ? keys[taken] : InputEvent::END_OF_INPUT;
+        event.time = std::chrono::steady_clock::now();
+        taken++;
+        return true;
+    }
+    void recordLatency(const InputEvent&) override {}
+
+    /**
+     * @return How many keys the game loop took so far.
+     */
+    size_t getTaken() {
+        return std::min(taken, keys.size());
+    }
+
+private:
+    const string& keys;
+    size_t taken = 0;
+};
+
+/**
+ * Play the given keys through the game loop until the level is over, the same way the game does (see GameLoop::update).
+ * Falls are resolved instantly, as in headless mode, so that they do not take their time on the clock.
+ *
+ * @return How many keys were taken.
+ */
+size_t playThroughLoop(GameLoop& loop, Player& player, World& world, Renderer& renderer, History& history, const string& keys) {
+    ScriptedKeys input = ScriptedKeys(keys);
+    loop.start(player);
+    player.setTickRate(0);
+    while (loop.update(player, world, renderer, &input, "", history)) {}
+    return input.getTaken();
+}
+
+// Amount of heap allocations made by the whole program so far
+unsigned long allocations = 0;
+
+/**
+ * Replaces the global allocation functions, so that every heap allocation is counted.
+ * The array and sized variants all end up here as well.
+ * They are kept out of line, as GCC mistakes the inlined malloc and free for mismatched allocation functions.
+ */
+[[gnu::noinline]] void* operator new(size_t size) {
+    allocations++;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+[[gnu::noinline]] void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * Get the duration between start and now in microseconds.
+ */
+double microsecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Get the amount of heap memory that is currently in use.
+ */
+size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+/**
+ * Prints the 50th and 99th percentile as well as the maximum of the given durations.
+ */
+void printPercentiles(string name, vector<double> durations) {
+    if (durations.empty()) return;
+    std::sort(durations.begin(), durations.end());
+    cout << name << ": p50 " << durations[durations.size() * 50 / 100] << "us"
+         << ", p99 " << durations[durations.size() * 99 / 100] << "us"
+         << ", max " << durations.back() << "us"
+         << " (" << durations.size() << " samples)" << endl;
+}
+
+/**
+ * Macro benchmark of a complete play session.
+ * Replays the inputs from TEST.txt in every world of the worlds directory, using the same line mapping as --test,
+ * and repeats this the given amount of times (at least 1, default 100).
+ *
+ * Reports how long loading a world takes, how many moves per second the game logic handles without rendering,
+ * how long each frame takes to render (falls are resolved instantly, as in headless mode) and how many bytes would have been written to the terminal.
+ * Frames are rendered into a null sink, so the terminal itself is not measured.
+ *
+ * Then, every world is played once more with the World and Renderer of the previous run, through the GameLoop with a History,
+ * like in the game. Every key of the replay is pressed, undone with U and pressed again. After the level was played once,
+ * the heap allocations of restarting it and playing it again are counted: every key, the move or undo it makes, the history and the redraw.
+ * Those have to be zero, otherwise the benchmark fails with exit code 1.
+ *
+ * Finally, every world is played by many players at once, to measure how much memory each of them needs:
+ * once with worlds copied from the level's template (see LevelPack) and once with worlds that are loaded on their own.
+ * Run from the project root, so that the worlds directory and TEST.txt can be found.
+ */
+int main(int argc, char *argv[]) {
+    unsigned int repetitions = argc > 1 ? std::stoul(argv[1]) : 100;
+    if (repetitions == 0) {
+        std::cerr << "Usage: bench [repetitions], with at least 1 repetition" << endl;
+        return 1;
+    }
+    vector<string> testFile = readFileAsVector("TEST.txt");
+    vector<string> worldFiles = getOrderedFileNames("./worlds");
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+
+    vector<double> loadTimes;
+    vector<double> frameTimes;
+    unsigned long moves = 0;
+    double moveTime = 0;
+    unsigned long bytesWritten = 0;
+    unsigned long steadyMoves = 0;
+    unsigned long steadyAllocations = 0;
+
+    for (unsigned int repetition = 0; repetition < repetitions; repetition++) {
+        for (unsigned int i = 0; i < worldFiles.size(); i++) {
+            string line = i + 2 < testFile.size() ? testFile[i + 2] : "";
+            string inputs = parseReplay(line).inputs;
+
+            // Game logic only
+            auto start = std::chrono::steady_clock::now();
+            World world = World(BlockRegistry());
+            world.loadFromFile(worldFiles[i]);
+            loadTimes.push_back(microsecondsSince(start));
+
+            start = std::chrono::steady_clock::now();
+            ReplayResult result = simulateReplay(world, line);
+            moveTime += microsecondsSince(start);
+            moves += result.inputsUsed;
+
+            // The same replay again, this time with rendering
+            World renderedWorld = World(BlockRegistry());
+            renderedWorld.loadFromFile(worldFiles[i]);
+            Player player = Player(renderedWorld.getStartPos(), renderedWorld);
+            Renderer renderer = Renderer(nullStream);
+
+            start = std::chrono::steady_clock::now();
+            renderer.render(renderedWorld, player.getSprite());
+            frameTimes.push_back(microsecondsSince(start));
+            for (char input : inputs) {
+                if (!player.isAlive() || player.hasReachedGoal()) break;
+                if (onInput(input, renderedWorld, player)) {
+                    start = std::chrono::steady_clock::now();
+                    renderer.redraw(renderedWorld, player.getSprite());
+                    frameTimes.push_back(microsecondsSince(start));
+                }
+            }
+            bytesWritten += renderer.getBytesWritten();
+            if (repetition + 1 < repetitions) continue;
+
+            // Play the world again through the game loop, reusing the warmed up World and Renderer.
+            // Loading the world, the first full frame and the first play may allocate: the history grows and every chunk
+            // is copied away from the start of the level the first time it changes. Restarting and playing again must not allocate.
+            string keys;
+            for (char input : inputs) keys += string{input, 'u', input};
+            renderedWorld.loadFromFile(worldFiles[i]);
+            Player steadyPlayer = Player(renderedWorld.getStartPos(), renderedWorld);
+            renderer.render(renderedWorld, steadyPlayer.getSprite());
+            GameLoop loop = GameLoop(LoopSettings());
+            History history = History(renderedWorld, steadyPlayer);
+            playThroughLoop(loop, steadyPlayer, renderedWorld, renderer, history, keys);
+            unsigned long allocationsBefore = allocations;
+            history.restart(); // What R does in the game loop, which does not take keys after the goal was reached
+            steadyMoves += playThroughLoop(loop, steadyPlayer, renderedWorld, renderer, history, keys);
+            steadyAllocations += allocations - allocationsBefore;
+        }
+    }
+
+    // Many players on the same level, each playing it to the goal. All of them are kept, so that their memory adds up.
+    const unsigned int players = 100;
+    LevelPack levels = LevelPack("./worlds");
+    size_t copiedBytes = 0;
+    size_t loadedBytes = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        string line = i + 2 < testFile.size() ? testFile[i + 2] : "";
+        vector<World> worlds;
+        worlds.reserve(2 * players);
+        levels.load(i); // Reads the level into its template, which is shared and not counted
+        size_t before = heapInUse();
+        for (unsigned int player = 0; player < players; player++) {
+            worlds.push_back(levels.load(i));
+            simulateReplay(worlds.back(), line);
+        }
+        copiedBytes += heapInUse() - before;
+        before = heapInUse();
+        for (unsigned int player = 0; player < players; player++) {
+            worlds.push_back(World(BlockRegistry()));
+            worlds.back().loadFromFile(levels.getLocation(i));
+            simulateReplay(worlds.back(), line);
+        }
+        loadedBytes += heapInUse() - before;
+    }
+
+    cout << "Worlds: " << worldFiles.size() << ", repetitions: " << repetitions << endl;
+    printPercentiles("World load time", loadTimes);
+    cout << "Moves: " << moves << " in " << moveTime / 1000 << "ms (" << static_cast<unsigned long>(moves / (moveTime / 1000000)) << " moves/s)" << endl;
+    printPercentiles("Render time per frame", frameTimes);
+    cout << "Bytes written to terminal: " << bytesWritten << " (" << bytesWritten / repetitions << " per repetition)" << endl;
+    if (levels.size() > 0)
+        cout << "Memory per player of a level: " << copiedBytes / (players * levels.size()) << " bytes when copied from the level's template, "
+             << loadedBytes / (players * levels.size()) << " bytes when loaded on its own" << endl;
+    cout << "Heap allocations in " << steadyMoves << " steady-state keys through the game loop: " << steadyAllocations << endl;
+    if (steadyAllocations > 0) {
+        std::cerr << "The game loop allocated on the heap after warming up" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,16 +1,35 @@
 #pragma once
+#include <cstdint>
 #include "identifier.hpp"
 #include "color.hpp"
 #include "blockSettings.hpp"
 
+/**
+ * Numeric id of a block, assigned by the BlockRegistry when the block is registered.
+ * There can be at most 256 distinct blocks (one per encoding character), so a single byte is enough.
+ */
+using BlockId = uint8_t;
+
+/**
+ * Compile-time description of a built-in block, used to create the block when the BlockRegistry is constructed.
+ */
+struct BlockDefinition {
+    const char* path;
+    char encoding;
+    Color color;
+    BlockSettings settings;
+};
+
 class Block {
 private:
     Identifier id = Identifier("adventure", "missing");
+    BlockId rawId = 0;
     char encoding;
     Color color;
     BlockSettings settings;
 
 public:
+    Block(const BlockDefinition& definition) : Block(Identifier("adventura", definition.path), definition.encoding, definition.color, definition.settings) {};
     Block(Identifier id, char encoding, BlockSettings settings) : Block(id, encoding, Color::RESET, settings) {};
     Block(Identifier id, char encoding, Color color, BlockSettings settings) {
         this->id = id;
@@ -19,17 +38,23 @@ public:
         this->settings = settings;
     };
 
-    BlockSettings getSettings() {
+    BlockSettings getSettings() const {
         return settings;
     }
 
-    Identifier getId() {
+    Identifier getId() const {
         return id;
     }
-    Color getColor() {
+    BlockId getRawId() const {
+        return rawId;
+    }
+    void setRawId(BlockId rawId) {
+        this->rawId = rawId;
+    }
+    Color getColor() const {
         return color;
     }
-    char getEncoding() {
+    char getEncoding() const {
         return encoding;
     }
     void setEncoding(char encoding) {
@@ -40,7 +65,7 @@ public:
         out << encoding;
         return out;
     }
-    bool operator==(Block otherBlock) {
-      return this->getId() == otherBlock.getId();
+    bool operator==(const Block& otherBlock) const {
+      return this->rawId == otherBlock.rawId;
     }
 };
@@ -7,28 +7,28 @@ public:
         this->x = x;
         this->y = y;
     }
-    int getX() {
+    int getX() const {
         return x;
     }
-    int getY() {
+    int getY() const {
         return y;
     }
-    unsigned int getUnsignedX() {
+    unsigned int getUnsignedX() const {
         return static_cast<unsigned int>(x);
     }
-    unsigned int getUnsignedY() {
+    unsigned int getUnsignedY() const {
         return static_cast<unsigned int>(y);
     }
-    bool isNegative() {
+    bool isNegative() const {
         return x < 0 || y < 0;
     }
-    BlockPos add(int x, int y) {
+    BlockPos add(int x, int y) const {
         return BlockPos(this->x + x, this->y + y);
     }
-    BlockPos operator+(BlockPos offset) {
+    BlockPos operator+(BlockPos offset) const {
         return BlockPos(this->getX() + offset.getX(), this->getY() + offset.getY());
     }
-    BlockPos operator-(BlockPos offset) {
+    BlockPos operator-(BlockPos offset) const {
         return BlockPos(this->getX() - offset.getX(), this->getY() - offset.getY());
     }
 };
\ No newline at end of file
@@ -1,26 +1,86 @@
 #pragma once
 #include <vector>
+#include <deque>
 #include <string>
+#include <array>
 #include "block.hpp"
+#include "trace.hpp"
 
 using std::vector;
 using std::string;
 
+/**
+ * Definitions of all built-in blocks, in the order they are registered in.
+ * The index of a block in this table is also its id.
+ */
+constexpr std::array<BlockDefinition, 10> BUILTIN_BLOCKS {{
+    {"air",      ' ', Color::RESET,          BlockSettingsBuilder().nonSolid().build()},
+    {"water",    '~', Color::BRIGHT_BLUE,    BlockSettingsBuilder().nonSolid().build()},
+    {"platform", '-', Color::RESET,          BlockSettingsBuilder().build()},
+    {"ladder",   'H', Color::BRIGHT_MAGENTA, BlockSettingsBuilder().climbableFromBottom().climbableFromTop().build()},
+    {"start",    'S', Color::RESET,          BlockSettingsBuilder().nonSolid().build()},
+    {"goal",     'O', Color::BRIGHT_GREEN,   BlockSettingsBuilder().nonSolid().build()},
+    {"wall",     '0', Color::RESET,          BlockSettingsBuilder().collidable().build()},
+    {"spike",    '^', Color::BRIGHT_RED,     BlockSettingsBuilder().lethal().build()},
+    {"box",      'x', Color::BRIGHT_CYAN,    BlockSettingsBuilder().pushable().collidable().gravity().build()},
+    {"sand",     '*', Color::BRIGHT_YELLOW,  BlockSettingsBuilder().brittle().gravity().build()}
+}};
+
+/**
+ * List of blocks that never moves its elements, so references to registered blocks stay valid
+ * when decorations are added later on. Lookups by id go through a table of pointers, which is rebuilt when the list is copied.
+ */
+class BlockList {
+public:
+    BlockList() {}
+    BlockList(const BlockList& other) : blocks(other.blocks) {
+        rebuildTable();
+    }
+    BlockList& operator=(const BlockList& other) {
+        blocks = other.blocks;
+        rebuildTable();
+        return *this;
+    }
+
+    void add(const Block& block) {
+        blocks.push_back(block);
+        table[blocks.size() - 1] = &blocks.back();
+    }
+    const Block& operator[](BlockId id) const {
+        return *table[id];
+    }
+    const Block& back() const {
+        return blocks.back();
+    }
+    size_t size() const {
+        return blocks.size();
+    }
+
+private:
+    std::deque<Block> blocks;
+    std::array<const Block*, 256> table;
+
+    void rebuildTable() {
+        for (size_t id = 0; id < blocks.size(); id++) table[id] = &blocks[id];
+    }
+};
+
 class BlockRegistry {
 public:
-    Block AIR = Block(Identifier("adventura", "air"), ' ', BlockSettingsBuilder().nonSolid().build());
-    Block WATER = Block(Identifier("adventura", "water"), '~', Color::BRIGHT_BLUE, BlockSettingsBuilder().nonSolid().build());
-    Block PLATFORM = Block(Identifier("adventura", "platform"), '-', BlockSettingsBuilder().build());
-    Block LADDER = Block(Identifier("adventura", "ladder"), 'H', Color::BRIGHT_MAGENTA, BlockSettingsBuilder().climbableFromBottom().climbableFromTop().build());
-    Block START = Block(Identifier("adventura", "start"), 'S', BlockSettingsBuilder().nonSolid().build());
-    Block GOAL = Block(Identifier("adventura", "goal"), 'O', Color::BRIGHT_GREEN, BlockSettingsBuilder().nonSolid().build());
-    Block WALL = Block(Identifier("adventura", "wall"), '0', BlockSettingsBuilder().collidable().build());
-    Block SPIKE = Block(Identifier("adventura", "spike"), '^', Color::BRIGHT_RED, BlockSettingsBuilder().lethal().build());
-    Block BOX = Block(Identifier("adventura", "box"), 'x', Color::BRIGHT_CYAN, BlockSettingsBuilder().pushable().collidable().gravity().build());
-    Block SAND = Block(Identifier("adventura", "sand"), '*', Color::BRIGHT_YELLOW, BlockSettingsBuilder().brittle().gravity().build());
+    Block AIR = Block(BUILTIN_BLOCKS[0]);
+    Block WATER = Block(BUILTIN_BLOCKS[1]);
+    Block PLATFORM = Block(BUILTIN_BLOCKS[2]);
+    Block LADDER = Block(BUILTIN_BLOCKS[3]);
+    Block START = Block(BUILTIN_BLOCKS[4]);
+    Block GOAL = Block(BUILTIN_BLOCKS[5]);
+    Block WALL = Block(BUILTIN_BLOCKS[6]);
+    Block SPIKE = Block(BUILTIN_BLOCKS[7]);
+    Block BOX = Block(BUILTIN_BLOCKS[8]);
+    Block SAND = Block(BUILTIN_BLOCKS[9]);
 
     BlockRegistry() {
-        registerBlock(AIR);
+        encodingTable.fill(UNREGISTERED);
+        registerBlock(AIR); // AIR has to be registered first, as id 0 is used for empty cells
         registerBlock(WATER);
         registerBlock(PLATFORM);
         registerBlock(LADDER);
@@ -32,17 +92,68 @@ public:
         registerBlock(SAND);
     }
 
-    const Block getByEncoding(char encoding) {
-        for (Block block : registeredBlocks) {
-            if (block.getEncoding() == encoding) return block;
+    /**
+     * Get the block that is represented by the given character in world files.
+     * 
+     * Characters that do not belong to any registered block are kept as purely visual decoration.
+     * The decoration block for each character is only created once and keeps its id for the lifetime of this registry.
+     * 
+     * @param encoding The character to look up.
+     * @return The block represented by that character.
+     */
+    const Block& getByEncoding(char encoding) {
+        Tracer::count(TraceCounter::ENCODING_LOOKUP);
+        uint16_t id = encodingTable[static_cast<unsigned char>(encoding)];
+        if (id == UNREGISTERED) {
+            Block decoration = Block(Identifier("decoration", string(1, encoding)), encoding, BlockSettingsBuilder().nonSolid().build());
+            id = registerBlock(decoration).getRawId();
         }
-        return Block(Identifier("decoration", string(1, encoding)), encoding, BlockSettingsBuilder().nonSolid().build()); // Keep other characters as decoration
+        return registeredBlocks[id];
+    }
+
+    /**
+     * Get the block that was registered with the given id.
+     * 
+     * @param id The numeric id of the block.
+     * @return The registered block.
+     */
+    const Block& getById(BlockId id) const {
+        return registeredBlocks[id];
+    }
+
+    /**
+     * Get the settings of the block with the given id, without going through the block itself.
+     * 
+     * @param id The numeric id of the block.
+     * @return The settings of that block.
+     */
+    BlockSettings getSettingsById(BlockId id) const {
+        return settingsTable[id];
+    }
+
+    /**
+     * @return The amount of registered blocks, including decorations. Ids range from 0 to this value (exclusive).
+     */
+    size_t getBlockCount() const {
+        return registeredBlocks.size();
     }
 
 private:
-    Block registerBlock(Block& block) {
-        registeredBlocks.push_back(block);
-        return block;
+    static constexpr unsigned int MAX_BLOCKS = 256;
+    static constexpr uint16_t UNREGISTERED = UINT16_MAX;
+
+    const Block& registerBlock(Block& block) {
+        block.setRawId(registeredBlocks.size());
+        registeredBlocks.add(block);
+        settingsTable[block.getRawId()] = block.getSettings();
+        // If two blocks share an encoding, the one registered first is used when loading worlds
+        uint16_t& encodingId = encodingTable[static_cast<unsigned char>(block.getEncoding())];
+        if (encodingId == UNREGISTERED) encodingId = block.getRawId();
+        return registeredBlocks.back();
     }
-    vector<Block> registeredBlocks;
+    BlockList registeredBlocks;
+    // Maps every possible encoding character to the id of its block
+    std::array<uint16_t, 256> encodingTable;
+    // Settings of every registered block by id, kept separately so that property checks only touch this small table
+    std::array<BlockSettings, MAX_BLOCKS> settingsTable;
 };
\ No newline at end of file
@@ -1,81 +1,104 @@
 #pragma once
+#include <cstdint>
+
+/**
+ * The physical properties of a block, packed into a single bitmask.
+ * Use BlockSettingsBuilder to create new settings.
+ */
 class BlockSettings {
     public:
-        BlockSettings() {}
-        bool isSolid() {
-            return isSolid_;
+        /**
+         * Bits used in the mask. They can be combined to check for multiple properties at once.
+         */
+        enum Flag : uint16_t {
+            SOLID                 = 1 << 0,
+            PUSHABLE              = 1 << 1,
+            CLIMBABLE_FROM_TOP    = 1 << 2,
+            CLIMBABLE_FROM_BOTTOM = 1 << 3,
+            LETHAL                = 1 << 4,
+            BRITTLE               = 1 << 5,
+            COLLISION             = 1 << 6,
+            GRAVITY               = 1 << 7
+        };
+
+        constexpr BlockSettings() {}
+        constexpr bool isSolid() const {
+            return has(SOLID);
+        }
+        constexpr bool hasCollision() const {
+            return has(COLLISION);
         }
-        bool hasCollision() {
-            return hasCollision_;
+        constexpr bool hasGravity() const {
+            return has(GRAVITY);
         }
-        bool hasGravity() {
-            return hasGravity_;
+        constexpr bool isPushable() const {
+            return has(PUSHABLE);
         }
-        bool isPushable() {
-            return isPushable_;
+        constexpr bool isLethal() const {
+            return has(LETHAL);
         }
-        bool isLethal() {
-            return isLethal_;
+        constexpr bool isBrittle() const {
+            return has(BRITTLE);
         }
-        bool isBrittle() {
-            return isBrittle_;
+        constexpr bool isClimbableFromTop() const {
+            return has(CLIMBABLE_FROM_TOP);
         }
-        bool isClimbableFromTop() {
-            return isClimbableFromTop_;
+        constexpr bool isClimbableFromBottom() const {
+            return has(CLIMBABLE_FROM_BOTTOM);
         }
-        bool isClimbableFromBottom() {
-            return isClimbableFromBottom_;
+        /**
+         * @param flags One or more flags combined with |.
+         * @return True if any of the given flags is set.
+         */
+        constexpr bool has(uint16_t flags) const {
+            return (this->flags & flags) != 0;
+        }
+        constexpr uint16_t getFlags() const {
+            return flags;
         }
 
         friend class BlockSettingsBuilder;
 
     private:
-        bool isSolid_ = true;
-        bool isPushable_ = false;
-        bool isClimbableFromTop_ = false;
-        bool isClimbableFromBottom_ = false;
-        bool isLethal_ = false;
-        bool isBrittle_ = false;
-        bool hasCollision_ = false;
-        bool hasGravity_ = false;
+        uint16_t flags = SOLID;
 };
 class BlockSettingsBuilder {
     public:
-        BlockSettingsBuilder nonSolid() {
-            blockSettings.isSolid_ = false;
+        constexpr BlockSettingsBuilder nonSolid() {
+            blockSettings.flags &= ~BlockSettings::SOLID;
             return *this;
         }
-        BlockSettingsBuilder pushable() {
-            blockSettings.isPushable_ = true;
+        constexpr BlockSettingsBuilder pushable() {
+            blockSettings.flags |= BlockSettings::PUSHABLE;
             return *this;
         }
-        BlockSettingsBuilder collidable() {
-            blockSettings.hasCollision_ = true;
+        constexpr BlockSettingsBuilder collidable() {
+            blockSettings.flags |= BlockSettings::COLLISION;
             return *this;
         }
-        BlockSettingsBuilder gravity() {
-            blockSettings.hasGravity_ = true;
+        constexpr BlockSettingsBuilder gravity() {
+            blockSettings.flags |= BlockSettings::GRAVITY;
             return *this;
         }
-        BlockSettingsBuilder lethal() {
-            blockSettings.isLethal_ = true;
+        constexpr BlockSettingsBuilder lethal() {
+            blockSettings.flags |= BlockSettings::LETHAL;
             return *this;
         }
-        BlockSettingsBuilder brittle() {
-            blockSettings.isBrittle_ = true;
+        constexpr BlockSettingsBuilder brittle() {
+            blockSettings.flags |= BlockSettings::BRITTLE;
             return *this;
         }
-        BlockSettingsBuilder climbableFromTop() {
-            blockSettings.isClimbableFromTop_ = true;
+        constexpr BlockSettingsBuilder climbableFromTop() {
+            blockSettings.flags |= BlockSettings::CLIMBABLE_FROM_TOP;
             return *this;
         }
-        BlockSettingsBuilder climbableFromBottom() {
-            blockSettings.isClimbableFromBottom_ = true;
+        constexpr BlockSettingsBuilder climbableFromBottom() {
+            blockSettings.flags |= BlockSettings::CLIMBABLE_FROM_BOTTOM;
             return *this;
         }
-        BlockSettings build() {
+        constexpr BlockSettings build() const {
             return blockSettings;
         }
     private:
         BlockSettings blockSettings = BlockSettings();
-};
\ No newline at end of file
+};
@@ -0,0 +1,98 @@
+#include <string>
+#include <iostream>
+#include <filesystem>
+
+#include "world.hpp"
+#include "blockRegistry.hpp"
+#include "levelPack.hpp"
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+/**
+ * Checks that both worlds have the same size, start position and blocks.
+ */
+bool sameWorld(World& expected, World& actual) {
+    if (expected.getMaxX() != actual.getMaxX() || expected.getMaxY() != actual.getMaxY()) return false;
+    if (expected.getStartPos().getX() != actual.getStartPos().getX() || expected.getStartPos().getY() != actual.getStartPos().getY()) return false;
+    for (unsigned int y = 0; y <= expected.getMaxY(); y++)
+        for (unsigned int x = 0; x <= expected.getMaxX(); x++)
+            if (expected.getBlockAt(BlockPos(x, y)).getEncoding() != actual.getBlockAt(BlockPos(x, y)).getEncoding()) return false;
+    return true;
+}
+
+/**
+ * Converts text worlds into precompiled levels (see levelFormat.hpp).
+ * Each world is written into the output directory with the same name and LEVEL_EXTENSION as extension,
+ * so that the output directory can be used as the worlds directory of the game.
+ * With --pack, all worlds are combined into a single level pack instead, in the order they are given in.
+ * Every level is loaded again after writing it and compared to the text world.
+ *
+ * Usage: convert <output directory> <world files...>
+ *        convert --pack <pack file> <world files...>
+ */
+int main(int argc, char *argv[]) {
+    bool pack = argc > 1 && string(argv[1]) == "--pack";
+    int firstWorld = pack ? 3 : 2;
+    if (argc <= firstWorld) {
+        cerr << "Usage: convert <output directory> <world files...>" << endl;
+        cerr << "       convert --pack <pack file> <world files...>" << endl;
+        return 1;
+    }
+    std::filesystem::path output = argv[firstWorld - 1];
+    if (!pack) std::filesystem::create_directories(output);
+
+    int exitCode = 0;
+    vector<string> names;
+    vector<string> levels;
+    for (int i = firstWorld; i < argc; i++) {
+        string worldFile = argv[i];
+        string name = std::filesystem::path(worldFile).stem().string() + string(LEVEL_EXTENSION);
+        World world = World(BlockRegistry());
+        world.loadFromFile(worldFile);
+        if (pack) {
+            names.push_back(name);
+            levels.push_back(world.saveToBinary());
+            continue;
+        }
+
+        string levelFile = (output / name).string();
+        if (!world.saveToBinaryFile(levelFile)) {
+            cerr << levelFile << ": could not be written" << endl;
+            exitCode = 1;
+            continue;
+        }
+        World level = World(BlockRegistry());
+        if (!level.loadFromBinaryFile(levelFile) || !sameWorld(world, level)) {
+            cerr << levelFile << ": does not match " << worldFile << " when loaded again" << endl;
+            exitCode = 1;
+            continue;
+        }
+        cout << worldFile << " -> " << levelFile << " (" << std::filesystem::file_size(levelFile) << " bytes)" << endl;
+    }
+    if (!pack) return exitCode;
+
+    string content = LevelPack::createPack(names, levels);
+    std::ofstream file(output, std::ios::binary);
+    file.write(content.data(), content.size());
+    file.close();
+    if (!file.good()) {
+        cerr << output.string() << ": could not be written" << endl;
+        return 1;
+    }
+    LevelPack written = LevelPack(output.string());
+    for (size_t i = 0; i < names.size(); i++) {
+        World world = World(BlockRegistry());
+        world.loadFromFile(argv[firstWorld + i]);
+        if (written.size() != names.size() || written.getName(i) != names[i]) return 1;
+        World level = written.load(i);
+        if (!sameWorld(world, level)) {
+            cerr << output.string() << ": level " << names[i] << " does not match " << argv[firstWorld + i] << " when loaded again" << endl;
+            return 1;
+        }
+    }
+    cout << names.size() << " worlds -> " << output.string() << " (" << content.size() << " bytes)" << endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+/**
+ * Write the given content as a C++ string literal. Lines of the file become lines of the literal, to keep the header readable.
+ * Everything but printable ASCII is escaped in octal, with all three digits so that no following digit is taken as part of it.
+ */
+void writeLiteral(std::ostream& out, const string& content) {
+    static const char* digits = "01234567";
+    out << "\"";
+    for (size_t i = 0; i < content.size(); i++) {
+        unsigned char c = content[i];
+        if (c == '\n') {
+            out << "\\n\"";
+            if (i + 1 < content.size()) out << "\n        \"";
+            else return;
+        }
+        else if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c >= 0x20 && c < 0x7f) out << c;
+        else out << '\\' << digits[c >> 6] << digits[(c >> 3) & 7] << digits[c & 7];
+    }
+    out << "\"";
+}
+
+/**
+ * Generates a header that builds the given files into the program, for builds with -DADVENTURA_EMBED (see fileutils.hpp).
+ * Embedded files are used instead of the ones on disk, so that the game starts without reading any file.
+ * The paths are stored relative to the project root, so run from there.
+ *
+ * Usage: embed <header> <files...>
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: embed <header> <files...>" << endl;
+        return 1;
+    }
+    std::ostringstream header;
+    header << "// Generated by embed.cpp, do not edit\n#pragma once\n\n";
+    header << "inline constexpr std::array<EmbeddedFile, " << argc - 2 << "> EMBEDDED_FILES = {{\n";
+    size_t totalSize = 0;
+    for (int i = 2; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            cerr << argv[i] << ": could not be read" << endl;
+            return 1;
+        }
+        std::ostringstream content;
+        content << file.rdbuf();
+        string path = std::filesystem::path(argv[i]).lexically_normal().generic_string();
+        header << "    {\"" << path << "\", std::string_view(\n        ";
+        writeLiteral(header, content.str());
+        header << ", " << content.str().size() << ")},\n";
+        totalSize += content.str().size();
+    }
+    header << "}};\n";
+
+    std::ofstream output(argv[1], std::ios::binary);
+    output << header.str();
+    output.close();
+    if (!output.good()) {
+        cerr << argv[1] << ": could not be written" << endl;
+        return 1;
+    }
+    cerr << argv[1] << ": " << argc - 2 << " files, " << totalSize << " bytes" << endl;
+    return 0;
+}
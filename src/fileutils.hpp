@@ -7,6 +7,14 @@
 #include <streambuf>
 #include <filesystem>
 #include <algorithm>
+#include <string_view>
+#include <array>
+#include <atomic>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "color.hpp"
 
@@ -18,6 +26,65 @@ using std::vector;
 
 string readInput(string feedback);
 
+/**
+ * A file that is built into the program, see embed.cpp.
+ */
+struct EmbeddedFile {
+    // Relative to the project root, without a leading "./"
+    std::string_view path;
+    std::string_view content;
+};
+
+#ifdef ADVENTURA_EMBED
+// Generated by the embed tool, defines EMBEDDED_FILES
+#include "embeddedFiles.hpp"
+#else
+inline constexpr std::array<EmbeddedFile, 0> EMBEDDED_FILES = {};
+#endif
+
+// Whether files built into the program are used instead of the ones on disk (see --from-disk)
+bool useEmbeddedFiles = true;
+// How often files or directories were read from disk, to check that embedded builds start without any
+std::atomic<unsigned long> fileSystemAccesses = 0;
+
+/**
+ * Find a file that is built into the program.
+ *
+ * @param fileLocation The path of the file, relative to the project root, e.g. "./screens/start.txt".
+ * @return The embedded file, or nullptr if it is not embedded or embedded files are disabled.
+ */
+const EmbeddedFile* findEmbeddedFile(const string& fileLocation) {
+    if (EMBEDDED_FILES.empty() || !useEmbeddedFiles) return nullptr;
+    string path = std::filesystem::path(fileLocation).lexically_normal().generic_string();
+    for (const EmbeddedFile& file : EMBEDDED_FILES)
+        if (file.path == path) return &file;
+    return nullptr;
+}
+
+/**
+ * Get the paths of all embedded files in the given directory (not in subdirectories), in the same form as the directory.
+ */
+vector<string> getEmbeddedFileNames(const string& dir) {
+    vector<string> files;
+    if (EMBEDDED_FILES.empty() || !useEmbeddedFiles) return files;
+    std::filesystem::path normalized = std::filesystem::path(dir).lexically_normal();
+    if (!normalized.has_filename()) normalized = normalized.parent_path(); // Trailing slash
+    for (const EmbeddedFile& file : EMBEDDED_FILES) {
+        std::filesystem::path path = std::filesystem::path(file.path);
+        if (path.parent_path() == normalized) files.push_back((std::filesystem::path(dir) / path.filename()).string());
+    }
+    return files;
+}
+
+/**
+ * @return Whether the given path is a directory, either built into the program or on disk.
+ */
+bool isDirectory(const string& location) {
+    if (!getEmbeddedFileNames(location).empty()) return true;
+    fileSystemAccesses++;
+    return std::filesystem::is_directory(location);
+}
+
 /**
  * Reads a string from the user. The string is expected to be the first
  * argument before a comma.
@@ -40,10 +107,13 @@ string readInput(string feedback) {
  * @return A list of all file names in the specified directory, sorted alphabetically.
  */
 vector<string> getOrderedFileNames(string dir) {
-    vector<string> worlds;
-    // Iterate over all files in the worlds directory
-    for (auto & entry : std::filesystem::directory_iterator(dir)) {
-        worlds.push_back(entry.path());
+    vector<string> worlds = getEmbeddedFileNames(dir);
+    if (worlds.empty()) {
+        fileSystemAccesses++;
+        // Iterate over all files in the worlds directory
+        for (auto & entry : std::filesystem::directory_iterator(dir)) {
+            worlds.push_back(entry.path());
+        }
     }
     // We use this to sort the worlds alphabetically, so that the game progresses in the correct order.
     std::sort( worlds.begin(), worlds.end(), [](string a, string b) {
@@ -55,6 +125,7 @@ vector<string> getOrderedFileNames(string dir) {
 /**
  * Reads the given file and returns its content as a vector of strings.
  * Each string represents a line in the file.
+ * Files that are built into the program are not read from disk.
  *
  * @param fileLocation The location of the file to read.
  * @return The content of the file as a vector of strings.
@@ -62,6 +133,17 @@ vector<string> getOrderedFileNames(string dir) {
 vector<string> readFileAsVector(const string& fileLocation) {
   
   vector<string> lines; 
+  if (const EmbeddedFile* embedded = findEmbeddedFile(fileLocation)) {
+      // Split the file into lines the same way std::getline would
+      std::string_view content = embedded->content;
+      for (size_t start = 0; start < content.size();) {
+          size_t end = content.find('\n', start);
+          if (end == std::string_view::npos) end = content.size();
+          lines.push_back(string(content.substr(start, end - start)));
+          start = end + 1;
+      }
+      return lines;
+  }
   // string currentLine = "";
   // for (char c : readFile(fileLocation)) {
   //   if (c == '\n' || c == '\r') {
@@ -74,6 +156,7 @@ vector<string> readFileAsVector(const string& fileLocation) {
   // }
   // file.push_back(currentLine);
 
+  fileSystemAccesses++;
   std::ifstream file(fileLocation);
   // Read the file line by line into a string
   string line;
@@ -90,11 +173,69 @@ vector<string> readFileAsVector(const string& fileLocation) {
  *
  * @param fileLocation Path to the file to be printed.
  * @param color Color to be used for the output.
+ * @param out Where to print the file, the console by default.
  */
-void printFile(string fileLocation, Color color) {
-    cout << color;
+void printFile(string fileLocation, Color color, std::ostream& out = cout) {
+    out << color;
     vector<string> file = readFileAsVector(fileLocation);
     for (unsigned int y = 0; y < file.size(); y++) {
-        cout << file.at(y) << endl;
+        out << file.at(y) << endl;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Read-only view of a complete file, mapped into memory.
+ * The pages of the file are only read from disk once they are accessed.
+ * Small files and files that can not be mapped are read into memory instead.
+ * Files that are built into the program are not read at all, their content is used directly.
+ */
+class MappedFile {
+public:
+    MappedFile(const string& fileLocation) {
+        if (const EmbeddedFile* file = findEmbeddedFile(fileLocation)) {
+            embedded = file->content;
+            return;
+        }
+        fileSystemAccesses++;
+        int fd = open(fileLocation.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info = {};
+        if (fstat(fd, &info) == 0 && info.st_size >= MIN_MAPPED_SIZE) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                mapped = static_cast<const char*>(mapping);
+                length = info.st_size;
+            }
+        }
+        // Mapping and unmapping costs more than copying a few pages, and pipes can not be mapped at all
+        if (mapped == nullptr) {
+            if (info.st_size > 0) fallback.reserve(info.st_size);
+            char buffer[4096];
+            for (ssize_t count = read(fd, buffer, sizeof(buffer)); count > 0; count = read(fd, buffer, sizeof(buffer)))
+                fallback.append(buffer, count);
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (mapped != nullptr) munmap(const_cast<char*>(mapped), length);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @return The content of the file.
+     */
+    std::string_view getContent() const {
+        if (embedded.data() != nullptr) return embedded;
+        if (mapped != nullptr) return std::string_view(mapped, length);
+        return std::string_view(fallback);
+    }
+
+private:
+    // Files smaller than this are read instead of mapped
+    static constexpr off_t MIN_MAPPED_SIZE = 64 * 1024;
+    const char* mapped = nullptr;
+    size_t length = 0;
+    string fallback;
+    std::string_view embedded;
+};
@@ -0,0 +1,46 @@
+#include <string>
+#include <iostream>
+
+#include "fuzz.hpp"
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+/**
+ * Stress test of the game logic: plays random input streams in the given worlds on all cores
+ * and checks the game's invariants after every move (see FuzzTarget).
+ * Every broken invariant is reported once per world, with the shortest inputs that were found to break it.
+ * Those are in the format of TEST.txt, so they can be replayed with --test or --headless.
+ *
+ * Usage: fuzz [--threads <n>] [--seconds <s>] [--seed <n>] [--length <n>] <world files...>
+ */
+int main(int argc, char *argv[]) {
+    FuzzOptions options;
+    vector<string> worldFiles;
+    for (int i = 1; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg == "--threads" && argc > i + 1) options.threads = std::stoul(argv[++i]);
+        else if (arg == "--seconds" && argc > i + 1) options.seconds = std::stod(argv[++i]);
+        else if (arg == "--seed" && argc > i + 1) options.seed = std::stoull(argv[++i]);
+        else if (arg == "--length" && argc > i + 1) options.length = std::stoul(argv[++i]);
+        else worldFiles.push_back(arg);
+    }
+    if (worldFiles.empty()) {
+        cerr << "Usage: fuzz [--threads <n>] [--seconds <s>] [--seed <n>] [--length <n>] <world files...>" << endl;
+        return 1;
+    }
+
+    // The game logs problems to cout, which counts as a failure while fuzzing
+    LogDetector logDetector;
+    std::streambuf* output = cout.rdbuf(&logDetector);
+    FuzzReport report = fuzzWorlds(worldFiles, options);
+    cout.rdbuf(output);
+
+    cout << report.moves << " moves in " << report.streams << " input streams in " << report.seconds << "s ("
+         << static_cast<unsigned long>(report.moves / report.seconds) << " moves/s)" << endl;
+    for (const FuzzFailure& failure : report.failures)
+        cout << failure.worldFile << ": not true that " << failure.invariant << ", shortest inputs found:" << endl << failure.inputs << endl;
+    return report.failures.empty() ? 0 : 1;
+}
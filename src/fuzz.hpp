@@ -0,0 +1,278 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <csignal>
+#include <cstdint>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "blockRegistry.hpp"
+#include "movementHandler.hpp"
+
+using std::string;
+using std::vector;
+
+struct FuzzOptions {
+    // Amount of threads to use, 0 uses all cores
+    unsigned int threads = 0;
+    // How long to fuzz for
+    double seconds = 5;
+    // Seed of the random input streams. The same seed and options generate the same streams on every thread.
+    uint64_t seed = 1;
+    // Length of every input stream. The world is restored to its start after every stream.
+    unsigned int length = 256;
+};
+
+struct FuzzFailure {
+    string worldFile;
+    // Which invariant did not hold
+    string invariant;
+    // The shortest input sequence found that still breaks the invariant, in the format of TEST.txt
+    string inputs;
+};
+
+struct FuzzReport {
+    unsigned long moves = 0;
+    unsigned long streams = 0;
+    double seconds = 0;
+    // The first failure per world and invariant
+    vector<FuzzFailure> failures;
+};
+
+/**
+ * Plays input streams in one world and checks the game's invariants after every move:
+ * - the player is never inside of a collidable block
+ * - the amount of boxes and sand (blocks with gravity) never changes
+ * - no block is ever placed outside of maxX and maxY, except for blocks with gravity that fell out of the bottom of the world
+ * - nothing is logged while moving, e.g. a block that was set at a negative position
+ * Unbounded recursion in tryPushBlock overflows the stack instead, which is reported by the crash handler.
+ */
+class FuzzTarget {
+public:
+    FuzzTarget(const string& worldFile) : worldFile(worldFile), world(World(BlockRegistry())) {
+        world.loadFromFile(worldFile);
+        world.decodeAllChunks();
+        const BlockRegistry& registry = world.getBlockRegistry();
+        for (size_t id = 0; id < registry.getBlockCount(); id++) {
+            if (registry.getSettingsById(id).hasGravity()) gravityBlocks.push_back(&registry.getById(id));
+        }
+        for (const Block* block : gravityBlocks) gravityAmounts.push_back(world.getBlockAmount(*block));
+        start = world.snapshot(); // Taken after counting, so that restoring it does not count again
+    }
+
+    const string& getWorldFile() {
+        return worldFile;
+    }
+
+    /**
+     * Play the given inputs from the start of the world, until an invariant breaks or the player dies or reaches the goal.
+     *
+     * @param inputs The keys to press.
+     * @param moves Increased by the amount of moves that were made.
+     * @return The invariant that broke, or an empty string if all of them held.
+     */
+    string play(const string& inputs, unsigned long& moves) {
+        world.restore(start);
+        world.clearDirtyCells();
+        Player player = Player(world.getStartPos(), world);
+        for (char input : inputs) {
+            if (!player.isAlive() || player.hasReachedGoal()) break;
+            currentInputs = &inputs;
+            logged = false;
+            onInput(input, world, player);
+            moves++;
+            string broken = checkInvariants(player);
+            world.clearDirtyCells();
+            if (!broken.empty()) return broken;
+        }
+        return "";
+    }
+
+    /**
+     * Find a shorter input sequence that breaks the same invariant, by removing parts of the inputs
+     * for as long as the invariant still breaks (a simple form of delta debugging).
+     *
+     * @param inputs Inputs that break the invariant.
+     * @param invariant The invariant they break, as returned by play.
+     * @return The shortest inputs that were found.
+     */
+    string shrink(string inputs, const string& invariant) {
+        unsigned long moves = 0;
+        for (size_t chunk = std::max<size_t>(inputs.size() / 2, 1); chunk > 0; chunk /= 2) {
+            for (size_t start = 0; start < inputs.size();) {
+                string candidate = inputs.substr(0, start) + inputs.substr(std::min(inputs.size(), start + chunk));
+                if (play(candidate, moves) == invariant) inputs = candidate;
+                else start += chunk;
+            }
+        }
+        return inputs;
+    }
+
+    /**
+     * Set while a move is made, so that the crash handler can print the inputs that led to the crash.
+     */
+    static inline thread_local const string* currentInputs = nullptr;
+    // Set if anything is written to cout during a move (see LogDetector)
+    static inline thread_local bool logged = false;
+
+private:
+    string worldFile;
+    World world;
+    World::Snapshot start;
+    vector<const Block*> gravityBlocks;
+    vector<unsigned int> gravityAmounts;
+
+    string checkInvariants(Player& player) {
+        if (logged) return "nothing is logged while moving";
+        if (player.isAlive()) {
+            BlockPos pos = player.getPos();
+            if (world.getSettingsAt(pos).hasCollision() || world.getSettingsAt(pos.add(0, 1)).hasCollision())
+                return "the player is not inside of a collidable block";
+        }
+        for (size_t i = 0; i < gravityBlocks.size(); i++) {
+            if (world.getBlockAmount(*gravityBlocks[i]) != gravityAmounts[i])
+                return "the amount of '" + string(1, gravityBlocks[i]->getEncoding()) + "' blocks stays the same";
+        }
+        for (BlockPos pos : world.getDirtyCells()) {
+            if (pos.getUnsignedX() > world.getMaxX() || pos.getUnsignedY() > world.getMaxY()) {
+                const Block& block = world.getBlockAt(pos);
+                bool fellOut = pos.getUnsignedX() <= world.getMaxX() && block.getSettings().hasGravity(); // See tryBlockGravity
+                if (block != world.getBlockRegistry().AIR && !fellOut) return "all blocks are within maxX and maxY";
+            }
+        }
+        return "";
+    }
+};
+
+/**
+ * Marks the current thread's FuzzTarget::logged whenever something is written to the stream it is installed in.
+ */
+class LogDetector : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        FuzzTarget::logged = true;
+        return c;
+    }
+};
+
+/**
+ * Generates input streams: purely random ones, and biased ones that favour one direction and repeat keys,
+ * which are much more likely to reach the borders of the world.
+ */
+class InputGenerator {
+public:
+    InputGenerator(uint64_t seed) : random(seed) {}
+
+    string next(unsigned int length) {
+        static constexpr std::array<char, 5> KEYS = {'w', 'a', 's', 'd', ' '};
+        string inputs;
+        inputs.reserve(length);
+        bool biased = random() % 2 == 0;
+        char favourite = KEYS[random() % KEYS.size()];
+        while (inputs.size() < length) {
+            char key = biased && random() % 3 != 0 ? favourite : KEYS[random() % KEYS.size()];
+            unsigned int repeat = biased ? 1 + random() % 8 : 1;
+            for (unsigned int i = 0; i < repeat && inputs.size() < length; i++) inputs += key;
+        }
+        return inputs;
+    }
+
+private:
+    std::mt19937_64 random;
+};
+
+/**
+ * Writes the inputs of the move that crashed the current thread to stderr, then lets the crash continue.
+ * Only uses functions that are safe to call from a signal handler.
+ */
+void printCrashingInputs(int signal) {
+    const char message[] = "\nCrashed while fuzzing, inputs up to the crash: ";
+    (void)!write(STDERR_FILENO, message, sizeof(message) - 1);
+    const string* inputs = FuzzTarget::currentInputs;
+    if (inputs != nullptr) (void)!write(STDERR_FILENO, inputs->data(), inputs->size());
+    (void)!write(STDERR_FILENO, "\n", 1);
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+/**
+ * Play random input streams in all given worlds on a pool of threads, for the configured time.
+ * Every thread loads its own copy of each world and plays streams in them in turns.
+ * Each failure is shrunk to a minimal reproducer before it is reported.
+ *
+ * @param worldFiles The worlds to fuzz.
+ * @param options How long and with how many threads to fuzz.
+ * @return The amount of moves made and the failures that were found.
+ */
+FuzzReport fuzzWorlds(const vector<string>& worldFiles, FuzzOptions options) {
+    unsigned int threads = options.threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.threads;
+    FuzzReport report;
+    std::mutex reportMutex;
+    std::atomic<unsigned long> totalMoves = 0;
+    std::atomic<unsigned long> totalStreams = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds));
+    // Only the first failure per world and invariant is shrunk and reported. Has to be called with reportMutex locked.
+    auto isKnown = [&](const string& worldFile, const string& invariant) {
+        return std::any_of(report.failures.begin(), report.failures.end(), [&](const FuzzFailure& failure) {
+            return failure.worldFile == worldFile && failure.invariant == invariant;
+        });
+    };
+
+    auto work = [&](unsigned int thread) {
+        // A stack overflow can only be reported on a stack of its own
+        static thread_local std::array<char, 64 * 1024> signalStack;
+        stack_t stack = {signalStack.data(), 0, signalStack.size()};
+        sigaltstack(&stack, nullptr);
+
+        vector<FuzzTarget> targets;
+        targets.reserve(worldFiles.size());
+        for (const string& worldFile : worldFiles) targets.emplace_back(worldFile);
+        InputGenerator generator = InputGenerator(options.seed + thread);
+        unsigned long moves = 0;
+        unsigned long streams = 0;
+        while (std::chrono::steady_clock::now() < end) {
+            for (FuzzTarget& target : targets) {
+                string inputs = generator.next(options.length);
+                string broken = target.play(inputs, moves);
+                streams++;
+                if (broken.empty()) continue;
+
+                {
+                    std::lock_guard lock(reportMutex);
+                    if (isKnown(target.getWorldFile(), broken)) continue;
+                }
+                string shrunk = target.shrink(inputs, broken);
+                std::lock_guard lock(reportMutex);
+                if (!isKnown(target.getWorldFile(), broken)) report.failures.push_back({target.getWorldFile(), broken, shrunk});
+            }
+        }
+        totalMoves += moves;
+        totalStreams += streams;
+    };
+
+    struct sigaction action = {};
+    action.sa_handler = printCrashingInputs;
+    action.sa_flags = SA_ONSTACK;
+    sigaction(SIGSEGV, &action, nullptr);
+    sigaction(SIGBUS, &action, nullptr);
+
+    vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++) pool.emplace_back(work, i);
+    work(0);
+    for (std::thread& thread : pool) thread.join();
+
+    report.moves = totalMoves;
+    report.streams = totalStreams;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
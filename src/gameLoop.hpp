@@ -0,0 +1,229 @@
+#pragma once
+#include <array>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "output.hpp"
+#include "input.hpp"
+#include "movementHandler.hpp"
+#include "history.hpp"
+
+using std::string;
+
+/**
+ * How fast the game loop runs.
+ */
+struct LoopSettings {
+    // Game logic updates per second. Animations are timed in ticks, so this does not change how fast the game plays.
+    unsigned int tickRate = 100;
+    // Maximum amount of frames drawn per second
+    unsigned int frameRate = 60;
+};
+
+/**
+ * Runs a level at a fixed pace, instead of sleeping wherever something has to wait.
+ *
+ * The game logic advances in fixed ticks: every tick applies the keys that were pressed since the last one
+ * (unless the player is falling) and advances running animations.
+ * Besides the movement keys, U undoes the last move and R restarts the level, using the given History.
+ * Frames are drawn at most frameRate times per second, and only if something changed since the last frame.
+ * In between, the loop sleeps until the next tick is due.
+ *
+ * If the loop falls behind, the missed ticks are caught up, at most MAX_CATCH_UP_TICKS at once.
+ * Ticks that run more than a tick late and frames that take longer than a frame to draw are counted as overruns.
+ *
+ * run() plays a whole level on the calling thread. Servers that run many levels on a few threads
+ * call start() once and then update() whenever getNextUpdate() is due or a key was pressed instead.
+ */
+class GameLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    GameLoop(LoopSettings settings) : settings(settings) {
+        this->settings.tickRate = std::max(1u, settings.tickRate);
+        this->settings.frameRate = std::max(1u, settings.frameRate);
+    }
+
+    /**
+     * Play the given world until the player dies, reaches the goal or the input ends.
+     * The world has to be rendered once before.
+     *
+     * @param player The player, whose falls are animated in ticks of this loop.
+     * @param world The world to play in.
+     * @param renderer The renderer that shows the world.
+     * @param input The source to take keys from. If nullptr (test mode), the keys in replay are used instead,
+     *              one every REPLAY_INTERVAL_MS milliseconds while the player is not falling.
+     * @param replay The keys to replay in test mode.
+     * @param history The history of the level, which every move is saved to.
+     */
+    void run(Player& player, World& world, Renderer& renderer, KeySource* input, const string& replay, History& history) {
+        start(player);
+        while (update(player, world, renderer, input, replay, history)) std::this_thread::sleep_until(nextTick);
+    }
+
+    /**
+     * Start playing a level, or continue it after it ended, e.g. after the player died and undid their last move.
+     * The world has to be rendered once before.
+     */
+    void start(Player& player) {
+        player.setTickRate(settings.tickRate);
+        replayWait = 0;
+        replayIndex = 0;
+        shownCount = 0;
+        ended = false;
+        nextTick = Clock::now();
+        nextFrame = nextTick;
+    }
+
+    /**
+     * Run the ticks that are due and draw a frame, if one is due and something changed.
+     * Once the level is over, the final frame is drawn. See run() for the parameters.
+     *
+     * @return False once the player died, reached the goal or the input ended.
+     */
+    bool update(Player& player, World& world, Renderer& renderer, KeySource* input, const string& replay, History& history) {
+        if (isRunning(player)) {
+            const Duration tickInterval = Duration(std::chrono::seconds(1)) / settings.tickRate;
+            const Duration frameInterval = Duration(std::chrono::seconds(1)) / settings.frameRate;
+            const unsigned int replayTicks = std::max(1u, REPLAY_INTERVAL_MS * settings.tickRate / 1000);
+
+            Clock::time_point now = Clock::now();
+            for (unsigned int caughtUp = 0; nextTick <= now && !ended; caughtUp++) {
+                if (caughtUp == MAX_CATCH_UP_TICKS) {
+                    nextTick = now; // Give up on the rest, the game slows down instead of freezing
+                    break;
+                }
+                if (now - nextTick > tickInterval) lateTicks++;
+                ticks++;
+                nextTick += tickInterval;
+
+                if (player.isFalling()) {
+                    player.tick();
+                }
+                else if (input == nullptr) {
+                    if (++replayWait < replayTicks) continue;
+                    replayWait = 0;
+                    if (replayIndex == replay.size()) ended = true;
+                    else applyKey(replay[replayIndex++], world, player, history);
+                }
+                else {
+                    InputEvent event;
+                    // Stop taking keys once one of them starts a fall, the rest are applied after landing
+                    while (!player.isFalling() && player.isAlive() && !player.hasReachedGoal() && shownCount < shown.size() && input->poll(event)) {
+                        if (event.key == InputEvent::END_OF_INPUT) {
+                            ended = true;
+                            break;
+                        }
+                        applyKey(event.key, world, player, history);
+                        shown[shownCount++] = event;
+                    }
+                }
+            }
+
+            now = Clock::now();
+            if (now >= nextFrame && !world.getDirtyCells().empty()) {
+                drawFrame(player, world, renderer, input, frameInterval);
+                nextFrame = now + frameInterval;
+            }
+        }
+        if (isRunning(player)) return true;
+        // Show the final state, e.g. the player standing in the goal
+        if (!world.getDirtyCells().empty()) drawFrame(player, world, renderer, input, Duration(std::chrono::seconds(1)) / settings.frameRate);
+        return false;
+    }
+
+    /**
+     * @return When update() has to be called next, unless a key is pressed before.
+     *         Clock::time_point::max() if nothing happens until a key is pressed.
+     */
+    Clock::time_point getNextUpdate(Player& player, World& world, KeySource* input) {
+        if (player.isFalling() || input == nullptr) return nextTick;
+        if (!world.getDirtyCells().empty()) return std::max(nextTick, nextFrame);
+        return Clock::time_point::max();
+    }
+
+    /**
+     * Continue after nothing happened for a while, e.g. because the player did not press any key.
+     * The ticks that were missed in the meantime are skipped instead of caught up.
+     */
+    void resume() {
+        nextTick = std::max(nextTick, Clock::now());
+    }
+
+    /**
+     * Print how many ticks and frames were run and how many of them overran, summed over all levels played so far.
+     */
+    void printStats(std::ostream& out) {
+        out << "Game loop: " << ticks << " ticks at " << settings.tickRate << "/s, " << lateTicks << " late; "
+            << frames << " frames at up to " << settings.frameRate << "/s, " << frameOverruns << " overran the frame time (slowest "
+            << slowestFrame << "ms)" << std::endl;
+    }
+
+    /**
+     * Add the ticks and frames of another loop to the ones of this loop, e.g. to sum up the loops of all sessions of a server.
+     */
+    void merge(const GameLoop& other) {
+        ticks += other.ticks;
+        lateTicks += other.lateTicks;
+        frames += other.frames;
+        frameOverruns += other.frameOverruns;
+        slowestFrame = std::max(slowestFrame, other.slowestFrame);
+    }
+
+private:
+    using Duration = std::chrono::nanoseconds;
+
+    // Test mode replays one key every REPLAY_INTERVAL_MS, to simulate the player's input
+    static constexpr unsigned int REPLAY_INTERVAL_MS = 100;
+    // Maximum amount of missed ticks that are run back to back
+    static constexpr unsigned int MAX_CATCH_UP_TICKS = 10;
+
+    LoopSettings settings;
+    std::array<InputEvent, 64> shown;
+    // Keys whose effect has not been drawn yet, to measure their latency
+    size_t shownCount = 0;
+    unsigned int replayWait = 0;
+    size_t replayIndex = 0;
+    bool ended = false;
+    Clock::time_point nextTick;
+    Clock::time_point nextFrame;
+    unsigned long ticks = 0;
+    unsigned long lateTicks = 0;
+    unsigned long frames = 0;
+    unsigned long frameOverruns = 0;
+    double slowestFrame = 0;
+
+    /**
+     * Apply a key to the game: undo, restart or one of the movement keys (see onInput).
+     */
+    void applyKey(char key, World& world, Player& player, History& history) {
+        if (is_in(key, 'u', 'U')) history.undo();
+        else if (is_in(key, 'r', 'R')) history.restart();
+        else {
+            history.save();
+            if (!onInput(key, world, player)) history.discard();
+        }
+    }
+
+    bool isRunning(Player& player) {
+        return !ended && player.isAlive() && (!player.hasReachedGoal() || player.isFalling());
+    }
+
+    void drawFrame(Player& player, World& world, Renderer& renderer, KeySource* input, Duration frameInterval) {
+        Clock::time_point start = Clock::now();
+        renderer.redraw(world, player.getSprite());
+        Duration duration = Clock::now() - start;
+        frames++;
+        if (duration > frameInterval) frameOverruns++;
+        slowestFrame = std::max(slowestFrame, std::chrono::duration<double, std::milli>(duration).count());
+
+        if (input != nullptr)
+            for (size_t i = 0; i < shownCount; i++) input->recordLatency(shown[i]);
+        shownCount = 0;
+    }
+};
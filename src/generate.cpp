@@ -0,0 +1,77 @@
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+
+#include "generator.hpp"
+#include "world.hpp"
+#include "blockRegistry.hpp"
+#include "simulation.hpp"
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+/**
+ * Generates a solvable world of the given size (see WorldGenerator) and writes it to the given file.
+ * The world is loaded again and the path through it is replayed, to make sure it really reaches the goal.
+ * The inputs of that path are printed to stdout in the same format as TEST.txt, with the final state hash appended.
+ * Statistics and errors are printed to stderr.
+ *
+ * Usage: generate [--width <n>] [--height <n>] [--seed <n>] [--ladder <d>] [--box <d>] [--sand <d>] [--spike <d>]
+ *                 [--water <d>] [--platform <d>] [--wall <d>] <world file>
+ * Densities are between 0 and 1. The width and height are at most 10000.
+ */
+int main(int argc, char *argv[]) {
+    GeneratorOptions options;
+    string worldFile;
+    for (int i = 1; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg == "--width" && argc > i + 1) options.width = std::stoul(argv[++i]);
+        else if (arg == "--height" && argc > i + 1) options.height = std::stoul(argv[++i]);
+        else if (arg == "--seed" && argc > i + 1) options.seed = std::stoull(argv[++i]);
+        else if (arg == "--ladder" && argc > i + 1) options.ladder = std::stod(argv[++i]);
+        else if (arg == "--box" && argc > i + 1) options.box = std::stod(argv[++i]);
+        else if (arg == "--sand" && argc > i + 1) options.sand = std::stod(argv[++i]);
+        else if (arg == "--spike" && argc > i + 1) options.spike = std::stod(argv[++i]);
+        else if (arg == "--water" && argc > i + 1) options.water = std::stod(argv[++i]);
+        else if (arg == "--platform" && argc > i + 1) options.platform = std::stod(argv[++i]);
+        else if (arg == "--wall" && argc > i + 1) options.wall = std::stod(argv[++i]);
+        else worldFile = arg;
+    }
+    if (worldFile.empty()) {
+        cerr << "Usage: generate [--width <n>] [--height <n>] [--seed <n>] [--ladder <d>] [--box <d>] [--sand <d>] [--spike <d>]" << endl;
+        cerr << "                [--water <d>] [--platform <d>] [--wall <d>] <world file>" << endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    GeneratedWorld generated = WorldGenerator(options).generate();
+    std::ofstream file(worldFile, std::ios::binary);
+    file.write(generated.content.data(), generated.content.size());
+    file.close();
+    if (!file.good()) {
+        cerr << worldFile << ": could not be written" << endl;
+        return 1;
+    }
+    auto generatedTime = std::chrono::steady_clock::now();
+
+    World world = World(BlockRegistry());
+    world.loadFromFile(worldFile);
+    auto loadedTime = std::chrono::steady_clock::now();
+    ReplayResult result = simulateReplay(world, generated.inputs, ReplayHashes::FINAL);
+    auto replayedTime = std::chrono::steady_clock::now();
+
+    cout << formatReplay(generated.inputs, result.hashes) << endl;
+    cerr << worldFile << ": " << world.getMaxX() + 1 << "x" << world.getMaxY() + 1 << ", " << generated.content.size() << " bytes, "
+         << generated.inputs.size() << " inputs; generated in " << std::chrono::duration<double, std::milli>(generatedTime - start).count()
+         << "ms, loaded in " << std::chrono::duration<double, std::milli>(loadedTime - generatedTime).count()
+         << "ms, replayed in " << std::chrono::duration<double, std::milli>(replayedTime - loadedTime).count() << "ms" << endl;
+    if (result.outcome != ReplayOutcome::GOAL) {
+        cerr << worldFile << ": the path does not reach the goal when replayed (" << toString(result.outcome) << " after "
+             << result.inputsUsed << " inputs at x: " << result.finalPos.getX() << ", y: " << result.finalPos.getY() << ")" << endl;
+        return 1;
+    }
+    return 0;
+}
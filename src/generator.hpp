@@ -0,0 +1,282 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include <random>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+
+#include "blockRegistry.hpp"
+
+using std::string;
+using std::vector;
+
+struct GeneratorOptions {
+    // Size of the world in cells, including the title line. At most MAX_SIZE in each direction.
+    unsigned int width = 200;
+    unsigned int height = 50;
+    // The same seed and options always generate the same world
+    uint64_t seed = 1;
+    // Share of the cells off the path that are filled with each block.
+    // The path itself only uses a block if its density is above 0, and more often the higher it is.
+    double ladder = 0.02;
+    double box = 0.02;
+    double sand = 0.02;
+    double spike = 0.02;
+    double water = 0.02;
+    // Share of the cells off the path that are filled with platforms and walls, which the other blocks can rest on
+    double platform = 0.08;
+    double wall = 0.02;
+
+    static constexpr unsigned int MIN_WIDTH = 8;
+    static constexpr unsigned int MIN_HEIGHT = 6;
+    static constexpr unsigned int MAX_SIZE = 10000;
+};
+
+struct GeneratedWorld {
+    // The world in the text format of the worlds directory
+    string content;
+    // Inputs that lead from the start to the goal, in the same format as the lines in TEST.txt
+    string inputs;
+};
+
+/**
+ * Generates worlds of any size that are guaranteed to be solvable, e.g. to measure how the game scales.
+ *
+ * First, a path is carved from the top left to the goal on the right, roughly following the diagonal of the world.
+ * It walks to the right over platforms, and changes rows by climbing ladders, dropping down (into water, if the drop is deep),
+ * or stepping onto walls. On the way, boxes have to be pushed into holes and sand collapses behind the player.
+ * The cells around the path are reserved, so nothing else can be placed where the player has to go.
+ * Every column is walked along by only one part of the path, so falling sand can never block a later part.
+ *
+ * Then, all other cells are filled randomly with the configured densities. Boxes and sand are only placed on top of
+ * blocks that never move, so they never fall onto the path.
+ */
+class WorldGenerator {
+public:
+    WorldGenerator(GeneratorOptions options) : options(options), random(options.seed) {
+        this->options.width = std::clamp(options.width, GeneratorOptions::MIN_WIDTH, GeneratorOptions::MAX_SIZE);
+        this->options.height = std::clamp(options.height, GeneratorOptions::MIN_HEIGHT, GeneratorOptions::MAX_SIZE);
+        width = this->options.width;
+        height = this->options.height;
+    }
+
+    GeneratedWorld generate() {
+        cells.assign(static_cast<size_t>(width) * height, AIR);
+        reserved.assign(static_cast<size_t>(width) * height, false);
+        inputs.clear();
+        carvePath();
+        fillOtherCells();
+        return {write(), inputs};
+    }
+
+private:
+    // Rows of the player's torso. The head has to stay below the title line, the block below the feet inside of the world.
+    static constexpr unsigned int TOP_ROW = 2;
+    // Falls that are longer than this kill the player, unless they end in water
+    static constexpr unsigned int SAFE_DROP = 5;
+    // Length of the straight runs between two changes of rows
+    static constexpr unsigned int MIN_RUN = 2;
+    static constexpr unsigned int MAX_RUN = 10;
+    static constexpr char AIR = BUILTIN_BLOCKS[0].encoding;
+    static constexpr char WATER = BUILTIN_BLOCKS[1].encoding;
+    static constexpr char PLATFORM = BUILTIN_BLOCKS[2].encoding;
+    static constexpr char LADDER = BUILTIN_BLOCKS[3].encoding;
+    static constexpr char START = BUILTIN_BLOCKS[4].encoding;
+    static constexpr char GOAL = BUILTIN_BLOCKS[5].encoding;
+    static constexpr char WALL = BUILTIN_BLOCKS[6].encoding;
+    static constexpr char SPIKE = BUILTIN_BLOCKS[7].encoding;
+    static constexpr char BOX = BUILTIN_BLOCKS[8].encoding;
+    static constexpr char SAND = BUILTIN_BLOCKS[9].encoding;
+
+    GeneratorOptions options;
+    std::mt19937_64 random;
+    unsigned int width;
+    unsigned int height;
+    vector<char> cells;
+    // Cells that belong to the path and must not be filled
+    vector<bool> reserved;
+    string inputs;
+
+    char& at(unsigned int x, unsigned int y) {
+        return cells[static_cast<size_t>(y) * width + x];
+    }
+
+    /**
+     * Put a block of the path into the cell, replacing whatever the path put there before.
+     */
+    void reserve(unsigned int x, unsigned int y, char block) {
+        at(x, y) = block;
+        reserved[static_cast<size_t>(y) * width + x] = true;
+    }
+
+    /**
+     * Keep the cell empty, unless the path already put a block into it.
+     */
+    void keepClear(unsigned int x, unsigned int y) {
+        if (!reserved[static_cast<size_t>(y) * width + x]) reserve(x, y, AIR);
+    }
+
+    /**
+     * Keep the cells of the player's head, torso and feet empty and put a block below the feet.
+     */
+    void stand(unsigned int x, unsigned int y, char floor) {
+        for (unsigned int row = y - 1; row <= y + 1; row++) keepClear(x, row);
+        reserve(x, y + 2, floor);
+    }
+
+    double chance() {
+        return (random() >> 11) * 0x1.0p-53;
+    }
+
+    unsigned int between(unsigned int min, unsigned int max) {
+        return min + random() % (max - min + 1);
+    }
+
+    /**
+     * @return Whether a feature of the path that uses a block with the given density should be placed.
+     */
+    bool usePathFeature(double density) {
+        return density > 0 && chance() < std::min(0.5, density * 5);
+    }
+
+    void carvePath() {
+        const unsigned int bottomRow = height - 3;
+        const unsigned int goalX = width - 2;
+        // The player starts three columns to the right of the 'S' (see World::loadFromFile)
+        unsigned int x = 3;
+        unsigned int y = TOP_ROW;
+        for (unsigned int column = 0; column < x; column++) stand(column, y, AIR);
+        reserve(0, y, START);
+        stand(x, y, PLATFORM);
+
+        while (x + 2 < goalX) {
+            unsigned int runEnd = std::min(goalX - 2, x + between(MIN_RUN, MAX_RUN));
+            while (x < runEnd) walk(x, y, runEnd);
+            if (x + 2 >= goalX) break;
+
+            // Follow the diagonal of the world, with some detours up and down
+            long target = TOP_ROW + static_cast<long>(bottomRow - TOP_ROW) * x / goalX + static_cast<long>(between(0, 8)) - 4;
+            unsigned int targetRow = std::clamp<long>(target, TOP_ROW, bottomRow);
+            if (targetRow > y) goDown(x, y, targetRow - y);
+            else if (targetRow < y) goUp(x, y, y - targetRow);
+        }
+        while (x < goalX) walk(x, y, goalX);
+        reserve(x, y, GOAL);
+    }
+
+    /**
+     * Walk one column to the right, or two if a box has to be pushed into a hole first.
+     * Stays left of or at runEnd, where the path changes rows.
+     */
+    void walk(unsigned int& x, unsigned int& y, unsigned int runEnd) {
+        // The box falls into the hole in front of it, so it fills the gap in the floor
+        if (x + 2 < runEnd && y + 3 < height && usePathFeature(options.box)) {
+            stand(x + 1, y, PLATFORM);
+            reserve(x + 1, y + 1, BOX);
+            stand(x + 2, y, AIR);
+            reserve(x + 2, y + 3, usePathFeature(options.spike) ? SPIKE : PLATFORM);
+            inputs += "dd";
+            x += 2;
+            return;
+        }
+        // Sand collapses as soon as the player walks off it, which is fine as the path never leads back
+        if (x + 1 < runEnd && y + 3 < height && usePathFeature(options.sand)) {
+            stand(x + 1, y, SAND);
+            reserve(x + 1, y + 3, AIR);
+        }
+        else stand(x + 1, y, PLATFORM);
+        inputs += 'd';
+        x++;
+    }
+
+    void goDown(unsigned int& x, unsigned int& y, unsigned int rows) {
+        if (usePathFeature(options.ladder) || (options.ladder > 0 && chance() < 0.5)) {
+            // A ladder below the player's feet, down to the floor of the next run
+            for (unsigned int row = y - 1; row <= y + rows + 1; row++) keepClear(x, row);
+            for (unsigned int row = y + 2; row <= y + rows + 1; row++) reserve(x, row, LADDER);
+            reserve(x, y + rows + 2, PLATFORM);
+            inputs += string(rows, 's');
+            y += rows;
+            return;
+        }
+        // Walk off the edge. A drop into water is never too deep, as the water resets the length of the fall.
+        bool pool = usePathFeature(options.water);
+        if (!pool) rows = std::min(rows, SAFE_DROP);
+        x++;
+        for (unsigned int row = y - 1; row <= y + rows + 1; row++) keepClear(x, row);
+        if (pool) reserve(x, y + rows + 1, WATER);
+        reserve(x, y + rows + 2, PLATFORM);
+        inputs += 'd';
+        y += rows;
+    }
+
+    void goUp(unsigned int& x, unsigned int& y, unsigned int rows) {
+        if (options.ladder > 0) {
+            // A ladder from the player's feet up to the floor of the next run
+            for (unsigned int row = y - rows - 1; row <= y + 1; row++) keepClear(x, row);
+            for (unsigned int row = y - rows + 2; row <= y + 1; row++) reserve(x, row, LADDER);
+            inputs += string(rows, 'w');
+            y -= rows;
+            return;
+        }
+        // Step onto a wall in front of the player's feet
+        x++;
+        for (unsigned int row = y - 2; row <= y; row++) keepClear(x, row);
+        reserve(x, y + 1, WALL);
+        inputs += 'd';
+        y--;
+    }
+
+    /**
+     * Fill every cell that is not reserved for the path, from the bottom up,
+     * so that boxes and sand can be stacked on top of blocks that never move.
+     */
+    void fillOtherCells() {
+        const std::array<std::pair<char, double>, 7> densities {{
+            {PLATFORM, options.platform}, {WALL, options.wall}, {LADDER, options.ladder}, {SPIKE, options.spike},
+            {WATER, options.water}, {BOX, options.box}, {SAND, options.sand}
+        }};
+        // Whether the cell below the current one never changes and is not AIR. Below the world, nothing can fall.
+        vector<bool> stableBelow(width, true);
+        vector<bool> stable(width);
+        for (unsigned int y = height - 1; y >= 1; y--) {
+            for (unsigned int x = 0; x < width; x++) {
+                if (!reserved[static_cast<size_t>(y) * width + x]) {
+                    double roll = chance();
+                    char block = AIR;
+                    for (const auto& [encoding, density] : densities) {
+                        if (roll < density) {
+                            block = encoding;
+                            break;
+                        }
+                        roll -= density;
+                    }
+                    if ((block == BOX || block == SAND) && !stableBelow[x]) block = AIR;
+                    at(x, y) = block;
+                    stable[x] = block != AIR;
+                }
+                // The boxes and sand of the path move while playing
+                else stable[x] = at(x, y) != AIR && at(x, y) != BOX && at(x, y) != SAND;
+            }
+            std::swap(stable, stableBelow);
+        }
+    }
+
+    /**
+     * @return The world in the text format, with a title line and without trailing AIR.
+     */
+    string write() {
+        string content = "Generierte Welt " + std::to_string(width) + "x" + std::to_string(height) + " (Seed " + std::to_string(options.seed) + ")";
+        content.reserve(cells.size() + height);
+        for (unsigned int y = 1; y < height; y++) {
+            const char* row = &cells[static_cast<size_t>(y) * width];
+            size_t length = width;
+            while (length > 0 && row[length - 1] == AIR) length--;
+            content += '\n';
+            content.append(row, length);
+        }
+        return content;
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+#include "world.hpp"
+#include "player.hpp"
+
+/**
+ * Remembers how to take back every move, so that moves can be undone and the level can be restarted without loading it again.
+ * Each move keeps the cells it changed together with their previous blocks (see World::ChangeLog) and the state of the player before it,
+ * so it only costs memory for the cells it changed, no matter how big the world is. Only the start of the level is kept as a whole.
+ * By default, every move since the start can be undone. The logs of the moves are kept when restarting and reused afterwards,
+ * so that playing the level again does not allocate until it takes more moves than before.
+ * With a limit, the moves are kept in a ring of at most maxMoves entries instead, whose logs are reused once it is full,
+ * and older moves are forgotten (see getForgottenMoves), so that a long game does not keep growing.
+ */
+class History {
+public:
+    // No limit on how many moves can be undone
+    static constexpr size_t UNLIMITED = 0;
+
+    /**
+     * Start the history at the current state, which is the state the level restarts at.
+     *
+     * @param maxMoves How many moves can be undone, or UNLIMITED. Older moves are forgotten.
+     */
+    History(World& world, Player& player, size_t maxMoves = UNLIMITED)
+        : world(world), player(player), maxMoves(maxMoves), start(world.snapshot()), startPlayer(player.getState()) {}
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+    ~History() {
+        world.record(nullptr);
+    }
+
+    /**
+     * Remember the current state, right before making a move.
+     * Every change to the world from now on belongs to this move, until the next one is saved.
+     */
+    void save() {
+        if (maxMoves != UNLIMITED && count == maxMoves) { // Forget the oldest move and reuse its entry
+            first = (first + 1) % moves.size();
+            count--;
+            forgotten++;
+        }
+        else if (count == moves.size()) moves.emplace_back(); // Only grows while the ring never wrapped, so first is still 0
+        Move& move = getMove(count++);
+        move.player = player.getState();
+        world.record(&move.world);
+    }
+
+    /**
+     * Forget the move that was saved last, because it did not change anything.
+     */
+    void discard() {
+        if (count == 0) return;
+        world.record(nullptr);
+        count--;
+    }
+
+    /**
+     * Go back to the state before the last move.
+     *
+     * @return False if there is no move to undo.
+     */
+    bool undo() {
+        if (count == 0) return false;
+        Move& move = getMove(count - 1);
+        world.revert(move.world);
+        player.setState(move.player);
+        count--;
+        return true;
+    }
+
+    /**
+     * Go back to the start of the level and forget all moves.
+     */
+    void restart() {
+        world.restore(start);
+        player.setState(startPlayer);
+        first = 0;
+        count = 0;
+        forgotten = 0;
+    }
+
+    /**
+     * Get how many moves were forgotten because of the limit since the start of the level, so that the player can be told
+     * why they cannot be undone.
+     *
+     * @return The amount of forgotten moves, always 0 without a limit.
+     */
+    size_t getForgottenMoves() {
+        return forgotten;
+    }
+
+    /**
+     * @return How many moves can be undone, or UNLIMITED.
+     */
+    size_t getMaxMoves() {
+        return maxMoves;
+    }
+
+private:
+    struct Move {
+        World::ChangeLog world;
+        Player::State player;
+    };
+
+    World& world;
+    Player& player;
+    size_t maxMoves;
+    World::Snapshot start;
+    Player::State startPlayer;
+    // The ring of moves: the oldest one is at first, and count moves follow it
+    std::vector<Move> moves;
+    size_t first = 0;
+    size_t count = 0;
+    size_t forgotten = 0;
+
+    Move& getMove(size_t index) {
+        return moves[(first + index) % moves.size()];
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+
+#include <termios.h>
+#include <poll.h>
+#include <unistd.h>
+
+/**
+ * A key pressed by the player, together with the time it was read.
+ */
+struct InputEvent {
+    // Sent once the input is closed, e.g. at the end of a piped file. No events follow it.
+    static constexpr char END_OF_INPUT = '\0';
+
+    char key;
+    std::chrono::steady_clock::time_point time;
+};
+
+/**
+ * Where a GameLoop takes the player's keys from.
+ */
+class KeySource {
+public:
+    virtual ~KeySource() = default;
+
+    /**
+     * Take the next key, without waiting.
+     *
+     * @param event Set to the next event, if there is one.
+     * @return False if no key was pressed since the last call.
+     */
+    virtual bool poll(InputEvent& event) = 0;
+
+    /**
+     * Remember how long it took until the effect of the given key was visible.
+     * Call this right after the frame that shows the effect was written.
+     */
+    virtual void recordLatency(const InputEvent& event) = 0;
+};
+
+/**
+ * How long it took until the effect of pressed keys was visible.
+ */
+struct LatencyStats {
+    unsigned long samples = 0;
+    double total = 0;
+    double max = 0;
+
+    void record(const InputEvent& event) {
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - event.time).count();
+        samples++;
+        total += milliseconds;
+        max = std::max(max, milliseconds);
+    }
+
+    void merge(const LatencyStats& other) {
+        samples += other.samples;
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    /**
+     * Print a summary to the given stream, if anything was recorded.
+     */
+    void print(std::ostream& out, unsigned long droppedEvents = 0) const {
+        if (samples == 0) return;
+        out << "Input latency: " << samples << " keys, average " << total / samples
+            << "ms, max " << max << "ms" << (droppedEvents > 0 ? ", " + std::to_string(droppedEvents) + " keys dropped" : "") << std::endl;
+    }
+};
+
+/**
+ * Queue with a fixed capacity that one thread can push to while another thread pops from it, without any locks.
+ * The capacity has to be a power of two.
+ */
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "The capacity of a SpscQueue has to be a power of two");
+public:
+    /**
+     * Add an item to the end of the queue. Only one thread may push.
+     *
+     * @return False if the queue is full, in which case the item is dropped.
+     */
+    bool push(const T& item) {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        if (write - readIndex.load(std::memory_order_acquire) == Capacity) return false;
+        items[write & (Capacity - 1)] = item;
+        writeIndex.store(write + 1, std::memory_order_release);
+        writeIndex.notify_one();
+        return true;
+    }
+
+    /**
+     * Take the item at the front of the queue, without waiting. Only one thread may pop.
+     *
+     * @return False if the queue is empty.
+     */
+    bool pop(T& item) {
+        size_t read = readIndex.load(std::memory_order_relaxed);
+        if (read == writeIndex.load(std::memory_order_acquire)) return false;
+        item = items[read & (Capacity - 1)];
+        readIndex.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Blocks the popping thread until the queue contains at least one item.
+     */
+    void waitUntilNotEmpty() {
+        writeIndex.wait(readIndex.load(std::memory_order_relaxed), std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> items;
+    // Both indices only ever grow, the slot is the index modulo the capacity.
+    // They are kept on separate cache lines, so that the two threads do not slow each other down.
+    alignas(64) std::atomic<size_t> writeIndex = 0;
+    alignas(64) std::atomic<size_t> readIndex = 0;
+};
+
+/**
+ * Reads the player's keys on a separate thread and queues them as InputEvents.
+ *
+ * If the input is a terminal, it is switched into raw mode for the lifetime of the reader:
+ * keys are available as soon as they are pressed, without waiting for Enter, and are not echoed.
+ * The previous terminal settings are restored on destruction and when the game is interrupted.
+ */
+class InputReader : public KeySource {
+public:
+    InputReader() {
+        rawMode = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &originalSettings) == 0;
+        if (rawMode) {
+            termios raw = originalSettings;
+            raw.c_lflag &= ~(ICANON | ECHO); // Ctrl+C still works, as ISIG stays enabled
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+            std::signal(SIGINT, restoreOnSignal);
+            std::signal(SIGTERM, restoreOnSignal);
+        }
+        reader = std::thread([this]() { readLoop(); });
+    }
+    ~InputReader() {
+        running = false;
+        reader.join();
+        if (rawMode) tcsetattr(STDIN_FILENO, TCSANOW, &originalSettings);
+    }
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+
+    /**
+     * Take the next key from the queue, without waiting.
+     *
+     * @param event Set to the next event, if there is one.
+     * @return False if no key was pressed since the last call.
+     */
+    bool poll(InputEvent& event) override {
+        return events.pop(event);
+    }
+
+    /**
+     * Wait for the next key.
+     *
+     * @return The next event. Once the input is closed, this is always END_OF_INPUT.
+     */
+    InputEvent next() {
+        InputEvent event;
+        if (ended) return {InputEvent::END_OF_INPUT, std::chrono::steady_clock::now()};
+        while (!events.pop(event)) events.waitUntilNotEmpty();
+        if (event.key == InputEvent::END_OF_INPUT) ended = true;
+        return event;
+    }
+
+    /**
+     * Drop all keys that were pressed so far, e.g. before asking the player something.
+     */
+    void discardPending() {
+        InputEvent event;
+        while (!ended && events.pop(event)) {
+            if (event.key == InputEvent::END_OF_INPUT) ended = true;
+        }
+    }
+
+    void recordLatency(const InputEvent& event) override {
+        latency.record(event);
+    }
+
+    /**
+     * Print a summary of the recorded latencies to the given stream.
+     */
+    void printLatency(std::ostream& out) {
+        latency.print(out, droppedEvents);
+    }
+
+private:
+    // How often the reading thread checks whether it should stop
+    static constexpr int POLL_TIMEOUT_MS = 50;
+    static inline termios originalSettings;
+
+    SpscQueue<InputEvent, 256> events;
+    std::thread reader;
+    std::atomic<bool> running = true;
+    std::atomic<unsigned long> droppedEvents = 0;
+    bool rawMode = false;
+    bool ended = false;
+    LatencyStats latency;
+
+    void readLoop() {
+        pollfd input = {STDIN_FILENO, POLLIN, 0};
+        while (running) {
+            int ready = ::poll(&input, 1, POLL_TIMEOUT_MS);
+            if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+
+            char buffer[64];
+            ssize_t count = ready < 0 ? -1 : read(STDIN_FILENO, buffer, sizeof(buffer));
+            auto time = std::chrono::steady_clock::now();
+            if (count <= 0) {
+                while (!events.push({InputEvent::END_OF_INPUT, time}) && running) std::this_thread::yield();
+                return;
+            }
+            for (ssize_t i = 0; i < count; i++) {
+                if (buffer[i] == InputEvent::END_OF_INPUT) continue;
+                if (!events.push({buffer[i], time})) droppedEvents++;
+            }
+        }
+    }
+
+    static void restoreOnSignal(int signal) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &originalSettings);
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+};
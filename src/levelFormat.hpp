@@ -0,0 +1,125 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+using std::string;
+
+/**
+ * Precompiled levels are stored in a binary format, so that they can be loaded without looking at every character.
+ * All numbers are stored little endian, one after another without any padding:
+ *
+ * - LEVEL_MAGIC, followed by the version (uint16) and the amount of bits per chunk side (uint8)
+ * - width and height of the world in blocks (uint32 each)
+ * - x and y of the player's start position (int32 each)
+ * - length of the title (uint16), followed by the title
+ * - size of the palette (uint16), followed by the encoding character of every block id used in the file
+ * - one uint32 per chunk, row by row: the index of the chunk's cells in the cell data, or EMPTY_CHUNK if it only contains AIR
+ * - the cell data: the block ids of every stored chunk, row by row inside of the chunk
+ */
+constexpr std::string_view LEVEL_MAGIC = "ADVL";
+constexpr uint16_t LEVEL_FORMAT_VERSION = 1;
+constexpr uint32_t EMPTY_CHUNK = UINT32_MAX;
+// File extension of precompiled levels
+constexpr std::string_view LEVEL_EXTENSION = ".bin";
+
+/**
+ * Level packs combine multiple precompiled levels into a single file, in the order they are played in:
+ *
+ * - PACK_MAGIC, followed by the version (uint16) and the amount of levels (uint32)
+ * - the index: for every level the length of its name (uint16), the name, and the offset and size of the level inside of the pack (uint32 each)
+ * - the levels, each in the format described above
+ */
+constexpr std::string_view PACK_MAGIC = "ADVP";
+constexpr uint16_t PACK_FORMAT_VERSION = 1;
+
+/**
+ * Reads the values of a level file one after another.
+ * Reading past the end of the file yields zeros and marks the reader as invalid, so a whole header can be read before checking.
+ */
+class LevelReader {
+public:
+    LevelReader(std::string_view content) : content(content) {}
+
+    uint8_t readUint8() {
+        return readNumber(1);
+    }
+    uint16_t readUint16() {
+        return readNumber(2);
+    }
+    uint32_t readUint32() {
+        return readNumber(4);
+    }
+    int32_t readInt32() {
+        return static_cast<int32_t>(readNumber(4));
+    }
+    std::string_view readBytes(size_t count) {
+        if (count > content.size() - offset) {
+            valid = false;
+            offset = content.size();
+            return {};
+        }
+        std::string_view bytes = content.substr(offset, count);
+        offset += count;
+        return bytes;
+    }
+    /**
+     * @return Everything that was not read yet.
+     */
+    std::string_view readRest() {
+        return readBytes(content.size() - offset);
+    }
+    /**
+     * @return False if any read went past the end of the file.
+     */
+    bool isValid() {
+        return valid;
+    }
+
+private:
+    std::string_view content;
+    size_t offset = 0;
+    bool valid = true;
+
+    uint32_t readNumber(unsigned int bytes) {
+        std::string_view data = readBytes(bytes);
+        uint32_t value = 0;
+        for (unsigned int i = 0; i < data.size(); i++) value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+        return value;
+    }
+};
+
+/**
+ * Assembles a level file in memory, in the same order as LevelReader reads it.
+ */
+class LevelWriter {
+public:
+    void writeUint8(uint8_t value) {
+        writeNumber(value, 1);
+    }
+    void writeUint16(uint16_t value) {
+        writeNumber(value, 2);
+    }
+    void writeUint32(uint32_t value) {
+        writeNumber(value, 4);
+    }
+    void writeInt32(int32_t value) {
+        writeNumber(static_cast<uint32_t>(value), 4);
+    }
+    void writeBytes(std::string_view bytes) {
+        data.append(bytes);
+    }
+    /**
+     * @return The file content written so far.
+     */
+    const string& getData() {
+        return data;
+    }
+
+private:
+    string data;
+
+    void writeNumber(uint32_t value, unsigned int bytes) {
+        for (unsigned int i = 0; i < bytes; i++) data += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+};
@@ -0,0 +1,182 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <filesystem>
+
+#include "fileutils.hpp"
+#include "levelFormat.hpp"
+#include "world.hpp"
+#include "blockRegistry.hpp"
+#include "trace.hpp"
+
+using std::string;
+using std::vector;
+
+/**
+ * The levels of the game, in the order they are played in.
+ *
+ * Levels are read from a level pack (see levelFormat.hpp), which is opened once and indexed up front.
+ * If the given location is a directory instead, every world file inside of it is a level, sorted alphabetically.
+ *
+ * Every level is only read once, into a template that all worlds loaded from it are copied from.
+ * The copies share the source file and every chunk that any of them decoded, and only own the chunks they change,
+ * so many players on the same level cost little more memory than one, and each chunk is decoded at most once.
+ * Levels can be loaded from several threads at once.
+ */
+class LevelPack {
+public:
+    /**
+     * @param location Path to a level pack or to a directory of text worlds or precompiled levels.
+     */
+    LevelPack(string location) {
+        if (isDirectory(location)) {
+            for (const string& worldFile : getOrderedFileNames(location))
+                levels.push_back({std::filesystem::path(worldFile).filename().string(), worldFile, {}});
+            return;
+        }
+
+        file = std::make_shared<MappedFile>(location);
+        std::string_view content = file->getContent();
+        LevelReader reader = LevelReader(content);
+        if (reader.readBytes(PACK_MAGIC.size()) != PACK_MAGIC || reader.readUint16() != PACK_FORMAT_VERSION) {
+            cout << "Invalid level pack: " << location << endl;
+            return;
+        }
+        uint32_t count = reader.readUint32();
+        for (uint32_t i = 0; i < count && reader.isValid(); i++) {
+            string name = string(reader.readBytes(reader.readUint16()));
+            uint32_t offset = reader.readUint32();
+            uint32_t size = reader.readUint32();
+            if (offset > content.size() || size > content.size() - offset) break;
+            levels.push_back({name, location + ":" + name, content.substr(offset, size)});
+        }
+        if (!reader.isValid() || levels.size() != count) {
+            cout << "Invalid level pack: " << location << endl;
+            levels = {};
+        }
+    }
+
+    /**
+     * @return The amount of levels.
+     */
+    size_t size() {
+        return levels.size();
+    }
+
+    /**
+     * @return The name of the level at the given index, which is its file name in a directory.
+     */
+    const string& getName(size_t index) {
+        return levels[index].name;
+    }
+
+    /**
+     * @return Where the level at the given index comes from, to identify it in reports.
+     */
+    const string& getLocation(size_t index) {
+        return levels[index].location;
+    }
+
+    /**
+     * Find a level by its name.
+     *
+     * @return The index of the level, or size() if there is no level with that name.
+     */
+    size_t indexOf(const string& name) {
+        for (size_t i = 0; i < levels.size(); i++)
+            if (levels[i].name == name) return i;
+        return levels.size();
+    }
+
+    /**
+     * Load the level at the given index into a new world, copied from the level's template.
+     * The level is read from its source the first time only. Its chunks are decoded on first access, like those of any other world.
+     *
+     * @param index The index of the level.
+     * @return The loaded world.
+     */
+    World load(size_t index) {
+        return World(*getTemplate(index));
+    }
+
+    /**
+     * Start loading the level at the given index on a background thread.
+     * Unlike load, every chunk is decoded on that thread as well, so playing the level never has to wait for the source file.
+     * The pack must not be destroyed before the level is taken from the returned future.
+     *
+     * @param index The index of the level.
+     * @return The loaded world, once it is ready.
+     */
+    std::future<World> preload(size_t index) {
+        return std::async(std::launch::async, [this, index]() {
+            World world = load(index);
+            world.decodeAllChunks();
+            return world;
+        });
+    }
+
+    /**
+     * Combine the given precompiled levels into a level pack.
+     *
+     * @param names The name of every level.
+     * @param levels The content of every level, as created by World::saveToBinary. levels[i] belongs to names[i].
+     * @return The content of the level pack file.
+     */
+    static string createPack(const vector<string>& names, const vector<string>& levels) {
+        size_t offset = PACK_MAGIC.size() + 2 + 4;
+        for (const string& name : names) offset += 2 + name.size() + 4 + 4;
+
+        LevelWriter writer;
+        writer.writeBytes(PACK_MAGIC);
+        writer.writeUint16(PACK_FORMAT_VERSION);
+        writer.writeUint32(names.size());
+        for (size_t i = 0; i < names.size(); i++) {
+            writer.writeUint16(names[i].size());
+            writer.writeBytes(names[i]);
+            writer.writeUint32(offset);
+            writer.writeUint32(levels[i].size());
+            offset += levels[i].size();
+        }
+        for (const string& level : levels) writer.writeBytes(level);
+        return writer.getData();
+    }
+
+private:
+    // Guards the templates, which are created on first use
+    std::mutex templateMutex;
+    vector<std::shared_ptr<const World>> templates;
+
+    /**
+     * Get the template of the level at the given index, reading it from its source if this is the first time.
+     * If two threads read the same level at once, both read it and the first one to finish wins.
+     */
+    std::shared_ptr<const World> getTemplate(size_t index) {
+        {
+            std::lock_guard lock(templateMutex);
+            if (templates.size() < levels.size()) templates.resize(levels.size());
+            if (templates[index]) return templates[index];
+        }
+        TraceSpan span("load", levels[index].name);
+        std::shared_ptr<World> world = std::make_shared<World>(BlockRegistry());
+        if (!file) world->loadFromFile(levels[index].location);
+        else if (!world->loadFromBinary(file, levels[index].data)) cout << "Invalid level file: " << levels[index].location << endl;
+
+        std::lock_guard lock(templateMutex);
+        if (!templates[index]) templates[index] = world;
+        return templates[index];
+    }
+
+    struct Level {
+        string name;
+        string location;
+        // The level's content inside of the pack, empty in a directory
+        std::string_view data;
+    };
+
+    // The opened level pack, nullptr for a directory
+    std::shared_ptr<MappedFile> file;
+    vector<Level> levels;
+};
@@ -0,0 +1,201 @@
+#include <string>
+#include <vector>
+#include <queue>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "levelPack.hpp"
+#include "simulation.hpp"
+#include "fileutils.hpp"
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::cerr;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+
+struct Client {
+    int fd = -1;
+    // How many keys of the script were sent
+    size_t sent = 0;
+    // When the last key was sent, while no output arrived after it
+    Clock::time_point waiting;
+    bool isWaiting = false;
+    bool closed = false;
+};
+
+/**
+ * @return The keys that play through every level in order, from the lines in TEST.txt,
+ *         preceded by a key that leaves the start screen. Keys after the goal was reached are left out.
+ */
+string buildScript(LevelPack& levels) {
+    vector<string> testFile = readFileAsVector("TEST.txt");
+    string script = "d";
+    for (size_t i = 0; i < levels.size(); i++) {
+        string line = i + 2 < testFile.size() ? testFile[i + 2] : "";
+        World world = levels.load(i);
+        ReplayResult result = simulateReplay(world, line, ReplayHashes::NONE);
+        if (result.outcome != ReplayOutcome::GOAL) {
+            cerr << levels.getLocation(i) << ": the line in TEST.txt does not reach the goal (" << toString(result.outcome) << ")" << endl;
+            return "";
+        }
+        script += parseReplay(line).inputs.substr(0, result.inputsUsed);
+    }
+    return script;
+}
+
+int connectTo(const string& socketPath) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+double percentile(vector<double>& sorted, double share) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(share * sorted.size()))];
+}
+
+/**
+ * Load generator for the server (see main --serve): connects many clients that play through every level at once,
+ * each pressing one key of the replays in TEST.txt per interval, just like a very steady player.
+ * Prints how many sessions reached the victory screen, the throughput and how long it took until
+ * the server answered a key, measured from sending it to receiving the next output.
+ *
+ * Usage: loadgen [--sessions <n>] [--interval <ms>] [--seconds <s>] [--worlds <directory or pack>] <socket>
+ */
+int main(int argc, char *argv[]) {
+    unsigned int sessionCount = 100;
+    unsigned int intervalMs = 100;
+    double seconds = 60;
+    string worldsLocation = "./worlds";
+    string socketPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg == "--sessions" && argc > i + 1) sessionCount = std::stoul(argv[++i]);
+        else if (arg == "--interval" && argc > i + 1) intervalMs = std::stoul(argv[++i]);
+        else if (arg == "--seconds" && argc > i + 1) seconds = std::stod(argv[++i]);
+        else if (arg == "--worlds" && argc > i + 1) worldsLocation = string(argv[++i]);
+        else socketPath = arg;
+    }
+    if (socketPath.empty()) {
+        cerr << "Usage: loadgen [--sessions <n>] [--interval <ms>] [--seconds <s>] [--worlds <directory or pack>] <socket>" << endl;
+        return 1;
+    }
+    LevelPack levels = LevelPack(worldsLocation);
+    string script = buildScript(levels);
+    if (script.empty()) return 1;
+
+    rlimit limit = {};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    vector<Client> clients(sessionCount);
+    // When each client sends its next key, the clients start spread over one interval
+    using Send = std::pair<Clock::time_point, size_t>;
+    std::priority_queue<Send, vector<Send>, std::greater<Send>> sends;
+    const auto interval = std::chrono::milliseconds(intervalMs);
+    const auto start = Clock::now();
+    unsigned int failed = 0;
+    for (size_t i = 0; i < clients.size(); i++) {
+        clients[i].fd = connectTo(socketPath);
+        if (clients[i].fd < 0) {
+            if (failed == 0) cerr << socketPath << ": " << std::strerror(errno) << endl;
+            clients[i].closed = true;
+            failed++;
+            continue;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].fd, &event);
+        sends.push({start + interval * i / clients.size(), i});
+    }
+
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    size_t open = clients.size() - failed;
+    unsigned long keysSent = 0;
+    unsigned long bytesReceived = 0;
+    unsigned int completed = 0;
+    vector<double> latencies;
+    vector<epoll_event> events(256);
+    vector<char> buffer(64 * 1024);
+    while (open > 0 && Clock::now() < deadline) {
+        Clock::time_point now = Clock::now();
+        while (!sends.empty() && sends.top().first <= now) {
+            auto [time, i] = sends.top();
+            sends.pop();
+            Client& client = clients[i];
+            if (client.closed || client.sent == script.size()) continue;
+            if (::send(client.fd, &script[client.sent], 1, MSG_NOSIGNAL | MSG_DONTWAIT) == 1) {
+                client.sent++;
+                keysSent++;
+                if (!client.isWaiting) {
+                    client.waiting = Clock::now();
+                    client.isWaiting = true;
+                }
+            }
+            sends.push({time + interval, i});
+        }
+
+        Clock::time_point wake = sends.empty() ? deadline : std::min(deadline, sends.top().first);
+        int timeout = std::max<long>(0, std::chrono::ceil<std::chrono::milliseconds>(wake - Clock::now()).count());
+        int ready = epoll_wait(epollFd, events.data(), events.size(), timeout);
+        for (int e = 0; e < ready; e++) {
+            Client& client = clients[events[e].data.u64];
+            while (!client.closed) {
+                ssize_t count = recv(client.fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+                if (count > 0) {
+                    bytesReceived += count;
+                    if (client.isWaiting) {
+                        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - client.waiting).count());
+                        client.isWaiting = false;
+                    }
+                    continue;
+                }
+                if (count < 0 && errno == EINTR) continue;
+                if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                // The server closes the connection after the victory screen
+                if (count == 0 && client.sent == script.size()) completed++;
+                client.closed = true;
+                close(client.fd);
+                open--;
+            }
+        }
+    }
+    double duration = std::chrono::duration<double>(Clock::now() - start).count();
+    for (Client& client : clients)
+        if (!client.closed) close(client.fd);
+
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double latency : latencies) total += latency;
+    cout << clients.size() << " sessions: " << completed << " completed, " << failed << " could not connect, " << open << " still running after "
+         << duration << "s" << endl;
+    cout << keysSent << " keys sent (" << static_cast<unsigned long>(keysSent / duration) << "/s), " << bytesReceived << " bytes received ("
+         << static_cast<unsigned long>(bytesReceived / duration / 1024) << " KiB/s)" << endl;
+    cout << "Time until the server answered a key: " << (latencies.empty() ? 0 : total / latencies.size()) << "ms on average, "
+         << percentile(latencies, 0.5) << "ms median, " << percentile(latencies, 0.99) << "ms for 99%, "
+         << (latencies.empty() ? 0 : latencies.back()) << "ms at most (" << latencies.size() << " keys)" << endl;
+    return completed == clients.size() ? 0 : 1;
+}
@@ -3,31 +3,61 @@
 
 #include <thread>
 #include <chrono>
+#include <optional>
 
 #include "world.hpp"
 #include "player.hpp"
 #include "blockRegistry.hpp"
 #include "movementHandler.hpp"
 #include "output.hpp"
+#include "simulation.hpp"
+#include "validation.hpp"
+#include "levelPack.hpp"
+#include "input.hpp"
+#include "gameLoop.hpp"
+#include "trace.hpp"
+#include "history.hpp"
+#include "server.hpp"
 
 using std::string;
 using std::cout;
 using std::endl;
 
-bool startWorld(string worldFile);
+int play(LevelPack& levels, string level, InputReader* input, GameLoop& loop);
+bool startWorld(World& world, InputReader* input, GameLoop& loop);
+int runHeadless(LevelPack& levels, string level, bool recordHashes);
+int runValidation(string dir, unsigned int threads);
+int runServer(LevelPack& levels, string socketPath, unsigned int threads, size_t maxUndo, LoopSettings loopSettings, bool reportTiming);
 vector<string> getOrderedFileNames(string dir);
+void markShown();
 
 bool testMode = false;
+bool headlessMode = false;
 unsigned int worldIndex = 2;
+// The levels to play: a level pack, or a directory of text worlds or precompiled levels
+string worldsLocation = "./worlds";
+// When the program started, and how long it took until the first screen was shown (see --timing)
+const std::chrono::steady_clock::time_point programStart = std::chrono::steady_clock::now();
+std::optional<double> startupTime;
+unsigned long startupFileSystemAccesses = 0;
 
 /**
  * Entry point of the program.
  * If a world file is provided as an argument, play through that world.
- * Otherwise, play through all worlds in the worlds directory.
+ * Otherwise, play through all worlds in the worlds directory (or level pack).
  * In case the player dies during gameplay, exit without printing the victory screen.
  * If the player reaches the goal of the final level, print the victory screen and exit.
  */
 int main(int argc, char *argv[]) {
+    string level = "";
+    string validationDir = "";
+    unsigned int threads = 0;
+    size_t maxUndo = History::UNLIMITED;
+    bool reportTiming = false;
+    bool recordHashes = false;
+    LoopSettings loopSettings;
+    string traceFile = "";
+    string socketPath = "";
     if (argc > 1) {
         for (int i = 1; i < argc; i++) {
             string arg = string(argv[i]);
@@ -35,30 +65,101 @@ int main(int argc, char *argv[]) {
                 break;
             else if (arg == "-t" || arg == "--test") 
                 testMode = true;
+            else if (arg == "--headless") 
+                headlessMode = true;
+            else if (arg == "--record-hashes") 
+                recordHashes = true;
+            else if (arg == "--validate" && argc > i + 1) 
+                validationDir = string(argv[++i]);
+            else if (arg == "--threads" && argc > i + 1) 
+                threads = std::stoul(argv[++i]);
+            else if (arg == "--worlds" && argc > i + 1) 
+                worldsLocation = string(argv[++i]);
+            else if (arg == "--timing") 
+                reportTiming = true;
+            else if (arg == "--tick-rate" && argc > i + 1) 
+                loopSettings.tickRate = std::stoul(argv[++i]);
+            else if (arg == "--fps" && argc > i + 1) 
+                loopSettings.frameRate = std::stoul(argv[++i]);
+            else if (arg == "--trace" && argc > i + 1) 
+                traceFile = string(argv[++i]);
+            else if (arg == "--serve" && argc > i + 1) 
+                socketPath = string(argv[++i]);
+            else if (arg == "--max-undo" && argc > i + 1) 
+                maxUndo = std::stoul(argv[++i]);
+            else if (arg == "--from-disk") 
+                useEmbeddedFiles = false;
             
             else if ((arg == "-l" || arg == "--level") && argc > i + 1) {
-                if (!startWorld("./worlds/" + string(argv[i+1])))
-                    return 0; // Load only the specified world
-                else
-                    printFile("./screens/completed_single_level.txt", Color::BRIGHT_GREEN);
-                return 0;
+                level = string(argv[i+1]);
+                break;
             }
         }
-        if (!testMode) {
-            printFile("./screens/help.txt", Color::BRIGHT_BLUE); // Print help screen
-            return 0;
+    }
+    // Everything from here on is traced if --trace is given, the trace is written when main returns
+    TraceSession trace = TraceSession(traceFile, std::cerr);
+    if (!validationDir.empty())
+        return runValidation(validationDir, threads);
+    if (argc > 1 && !testMode && !headlessMode && socketPath.empty() && level.empty() && worldsLocation == "./worlds") {
+        printFile("./screens/help.txt", Color::BRIGHT_BLUE); // Print help screen
+        return 0;
+    }
+    LevelPack levels = LevelPack(worldsLocation);
+    if (headlessMode) 
+        return runHeadless(levels, level, recordHashes);
+    if (!socketPath.empty())
+        return runServer(levels, socketPath, threads, maxUndo, loopSettings, reportTiming);
+    // Keys are read on a separate thread, except in test mode, where they come from TEST.txt
+    std::optional<InputReader> input;
+    if (!testMode) input.emplace();
+    GameLoop loop = GameLoop(loopSettings);
+    int exitCode = play(levels, level, input ? &*input : nullptr, loop);
+    if (reportTiming) {
+        if (startupTime)
+            std::cerr << "Startup: " << *startupTime << "ms until the first screen was shown, " << startupFileSystemAccesses
+                      << " file system accesses until then, " << fileSystemAccesses << " in total" << endl;
+        loop.printStats(std::cerr);
+        if (input) input->printLatency(std::cerr);
+    }
+    return exitCode;
+}
+
+/**
+ * Play the given level, or every level in order if no level name is given.
+ * Keys are taken from the given input reader, or from TEST.txt if there is none.
+ * @return 0 once the game is over, 1 if the given level does not exist
+ */
+int play(LevelPack& levels, string level, InputReader* input, GameLoop& loop) {
+    if (!level.empty()) {
+        size_t index = levels.indexOf(level);
+        if (index == levels.size()) {
+            cout << "Unknown level: " << level << endl;
+            return 1;
         }
+        World world = levels.load(index);
+        if (!startWorld(world, input, loop))
+            return 0; // Load only the specified world
+        else
+            printFile("./screens/completed_single_level.txt", Color::BRIGHT_GREEN);
+        return 0;
     }
-    if (!testMode) {
+    // The first level is loaded in the background while the start screens are shown
+    std::future<World> nextWorld;
+    if (levels.size() > 0) nextWorld = levels.preload(0);
+    if (input != nullptr) {
         printFile("./screens/start.txt", Color::BRIGHT_YELLOW);
-        waitForInput();
+        markShown();
+        waitForInput(*input);
         printGuide();
-        waitForInput();
+        waitForInput(*input);
     }
     
-    // Load every world in order
-    for (const auto & world : getOrderedFileNames("./worlds"))
-        if (!startWorld(world)) return 0;
+    // Play every world in order, while the next one is loaded in the background
+    for (size_t i = 0; i < levels.size(); i++) {
+        World world = nextWorld.get();
+        if (i + 1 < levels.size()) nextWorld = levels.preload(i + 1);
+        if (!startWorld(world, input, loop)) return 0;
+    }
     // Print the victory screen once all levels have been completed
     printFile("./screens/victory.txt", Color::BRIGHT_GREEN);
 
@@ -66,22 +167,118 @@ int main(int argc, char *argv[]) {
 }
 
 /**
- * Start a new world defined in the file at worldFile.
+ * Start playing the given world, which has already been loaded, in the given game loop.
+ * Keys are taken from the given input reader, or from TEST.txt if there is none.
  * If the player reaches the goal, return true.
- * In case they die, print the death screen and return false.
+ * In case they die, print the death screen. When playing interactively, the player can then undo the last move
+ * or restart the level and keep playing. Otherwise, return false.
  * @return true if the player reached the goal, false in case of death
  */
-bool startWorld(string worldFile) {
-    BlockRegistry blockRegistry = BlockRegistry();
-    World world = World(blockRegistry);
-    
-    world.loadFromFile(worldFile);
+bool startWorld(World& world, InputReader* input, GameLoop& loop) {
     Player player = Player(world.getStartPos(), world);
-    render(world, player.mapToWorldspace());
+    Renderer renderer = Renderer();
+    renderer.render(world, player.getSprite());
+    markShown();
     
-    inputLoop(player, world, testMode, worldIndex);
+    string replay = "";
+    if (input == nullptr) {
+        static const vector<string> testFile = readFileAsVector("TEST.txt"); // Read once for all levels
+        if (worldIndex < testFile.size()) replay = parseReplay(testFile[worldIndex]).inputs;
+    }
+    History history = History(world, player);
+    loop.run(player, world, renderer, input, replay, history);
+    while (input != nullptr && !player.isAlive()) {
+        printFile("./screens/death.txt", Color::BRIGHT_RED);
+        printFile("./screens/retry.txt", Color::BRIGHT_YELLOW);
+        input->discardPending(); // Keys pressed before the question was shown are no answer to it
+        char key = input->next().key;
+        if (is_in(key, 'u', 'U')) history.undo();
+        else if (is_in(key, 'r', 'R')) history.restart();
+        else break;
+        renderer.render(world, player.getSprite());
+        loop.run(player, world, renderer, input, "", history);
+    }
 
     worldIndex++;
-    if (!player.isAlive()) printFile("./screens/death.txt", Color::BRIGHT_RED);
+    if (input == nullptr && !player.isAlive()) printFile("./screens/death.txt", Color::BRIGHT_RED);
     return player.hasReachedGoal();
-}
\ No newline at end of file
+}
+
+/**
+ * Replay the inputs from TEST.txt in each of the given levels without rendering or waiting.
+ * If a level name is given, only that level is replayed.
+ * Prints one line per world with the outcome, the player's final position, the final state hash and the time it took.
+ * If the line in TEST.txt carries expected state hashes, the first step whose state differs is reported as well.
+ * With recordHashes, the lines of TEST.txt are printed instead, with the state hash after every step appended.
+ * @return 0 if the goal was reached in every world and all expected hashes matched, 1 otherwise
+ */
+int runHeadless(LevelPack& levels, string level, bool recordHashes) {
+    if (!level.empty() && levels.indexOf(level) == levels.size()) {
+        cout << "Unknown level: " << level << endl;
+        return 1;
+    }
+    vector<string> testFile = readFileAsVector("TEST.txt");
+    int exitCode = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (!level.empty() && levels.getName(i) != level) continue;
+        auto start = std::chrono::steady_clock::now();
+        World world = levels.load(i);
+        string line = worldIndex + i < testFile.size() ? testFile[worldIndex + i] : "";
+        ReplayResult result = simulateReplay(world, line, recordHashes ? ReplayHashes::EVERY_STEP : ReplayHashes::FINAL);
+        auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        if (result.outcome != ReplayOutcome::GOAL || result.diverged) exitCode = 1;
+        if (recordHashes) {
+            cout << formatReplay(parseReplay(line).inputs, result.hashes) << endl;
+            continue;
+        }
+
+        cout << levels.getLocation(i) << ": " << toString(result.outcome) << " (x: " << result.finalPos.getX() << ", y: " << result.finalPos.getY() << ")"
+             << " after " << result.inputsUsed << " inputs in " << duration.count() << "ms, state " << formatHash(result.hashes.back()) << endl;
+        if (result.diverged)
+            cout << levels.getLocation(i) << ": diverged after step " << result.divergedStep << ", expected state " << formatHash(result.expectedHash)
+                 << " but got " << formatHash(result.actualHash) << endl;
+    }
+    return exitCode;
+}
+
+/**
+ * Check every world in the given directory against its line in TEST.txt, using the same line mapping as --test.
+ * The worlds are checked in parallel and the results are printed as JSON lines.
+ * @return 0 if the goal was reached in every world, 1 otherwise
+ */
+int runValidation(string dir, unsigned int threads) {
+    auto start = std::chrono::steady_clock::now();
+    vector<string> testFile = readFileAsVector("TEST.txt");
+    vector<string> replays = testFile.size() > 2 ? vector<string>(testFile.begin() + 2, testFile.end()) : vector<string>();
+    vector<ValidationResult> results = validateWorlds(getOrderedFileNames(dir), replays, threads);
+    auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    return printValidationReport(results, duration.count(), cout) ? 0 : 1;
+}
+
+/**
+ * Let many players play at once, each in their own session, by connecting to the given Unix socket.
+ * Every session plays through all levels in order, just like the local game.
+ * Each session can undo its last maxUndo moves, or all of them with History::UNLIMITED.
+ * Runs until SIGINT or SIGTERM is received, then prints the statistics of all sessions if reportTiming is set.
+ * @return 0 after shutting down, 1 if the socket could not be opened
+ */
+int runServer(LevelPack& levels, string socketPath, unsigned int threads, size_t maxUndo, LoopSettings loopSettings, bool reportTiming) {
+    ServerSettings settings;
+    settings.threads = threads;
+    settings.maxUndo = maxUndo;
+    settings.loop = loopSettings;
+    Server server = Server(levels, settings);
+    int exitCode = server.run(socketPath);
+    if (reportTiming) server.printStats(std::cerr);
+    return exitCode;
+}
+
+/**
+ * Remember how long it took from the start of the program until the first screen was shown, and how many files were read until then.
+ * Only the first call counts.
+ */
+void markShown() {
+    if (startupTime) return;
+    startupTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - programStart).count();
+    startupFileSystemAccesses = fileSystemAccesses;
+}
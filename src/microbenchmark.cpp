@@ -0,0 +1,96 @@
+#include <string>
+#include <iostream>
+#include <chrono>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "blockRegistry.hpp"
+#include "movementHandler.hpp"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+// Results are accumulated here and printed at the end, so that the compiler can not optimize the measured code away
+unsigned long sink = 0;
+
+/**
+ * Runs the given function the given amount of times and prints the average time per call.
+ *
+ * @param name Name of the measurement, printed in front of the result.
+ * @param iterations How often the function should be called.
+ * @param opsPerIteration How many operations a single call performs, used to calculate the time per operation.
+ * @param function The code to measure.
+ */
+template<typename Function>
+void measure(string name, unsigned long iterations, unsigned long opsPerIteration, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++) function();
+    auto duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    cout << name << ": " << duration.count() / (iterations * opsPerIteration) << " ns/op" << endl;
+}
+
+/**
+ * Microbenchmarks for the hot paths of the game logic:
+ * loading text worlds and precompiled levels, decoding blocks, comparing blocks and moving the player.
+ * Run from the project root, so that the worlds directory can be found.
+ */
+int main(int argc, char *argv[]) {
+    unsigned long iterations = argc > 1 ? std::stoul(argv[1]) : 1000;
+
+    for (const auto & worldFile : getOrderedFileNames("./worlds")) {
+        measure("loadFromFile " + worldFile, iterations, 1, [&]() {
+            World world = World(BlockRegistry());
+            world.loadFromFile(worldFile);
+            sink += world.getMaxX();
+        });
+
+        // The same world as a precompiled level
+        World textWorld = World(BlockRegistry());
+        textWorld.loadFromFile(worldFile);
+        string levelFile = (std::filesystem::temp_directory_path() / "microbenchmark").string() + string(LEVEL_EXTENSION);
+        textWorld.saveToBinaryFile(levelFile);
+        measure("loadFromBinaryFile " + worldFile, iterations, 1, [&]() {
+            World world = World(BlockRegistry());
+            world.loadFromBinaryFile(levelFile);
+            sink += world.getMaxX();
+        });
+        std::filesystem::remove(levelFile);
+    }
+
+    vector<string> file = readFileAsVector("./worlds/5.txt");
+    unsigned long characters = 0;
+    for (const string& line : file) characters += line.size();
+    BlockRegistry blockRegistry = BlockRegistry();
+    measure("getByEncoding", iterations, characters, [&]() {
+        for (const string& line : file)
+            for (char c : line) sink += blockRegistry.getByEncoding(c).getRawId();
+    });
+
+    World world = World(BlockRegistry());
+    world.loadFromFile("./worlds/5.txt");
+    unsigned long cells = (world.getMaxX() + 1) * (world.getMaxY() + 1);
+    measure("getBlockAt == AIR", iterations, cells, [&]() {
+        for (unsigned int y = 0; y <= world.getMaxY(); y++)
+            for (unsigned int x = 0; x <= world.getMaxX(); x++)
+                sink += world.getBlockAt(BlockPos(x, y)) == world.getBlockRegistry().AIR;
+    });
+
+    measure("anyInRow lethal|solid", iterations, world.getMaxY() + 1, [&]() {
+        for (unsigned int y = 0; y <= world.getMaxY(); y++)
+            sink += world.anyInRow(y, 0, world.getMaxX(), BlockSettings::LETHAL | BlockSettings::SOLID);
+    });
+
+    // Walk back and forth on the flat ground next to the start of the first world, so that the player never falls
+    World walkWorld = World(BlockRegistry());
+    walkWorld.loadFromFile("./worlds/1.txt");
+    Player player = Player(walkWorld.getStartPos(), walkWorld);
+    measure("move", iterations * 100, 2, [&]() {
+        sink += onInput('d', walkWorld, player);
+        sink += onInput('a', walkWorld, player);
+        walkWorld.clearDirtyCells();
+    });
+
+    cout << "(checksum " << sink << ")" << endl;
+    return 0;
+}
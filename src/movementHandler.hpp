@@ -5,6 +5,7 @@
 #include "world.hpp"
 #include "blockRegistry.hpp"
 #include "output.hpp"
+#include "input.hpp"
 
 bool tryWalk(World& world, Player& player, bool left);
 bool tryGoDown(World& world, Player& player);
@@ -30,12 +31,12 @@ bool is_in(First &&first, T && ... t) {
 }
 
 /**
- * Waits until the user enters a key.
+ * Waits until the user presses one of the movement keys, or the input is closed.
  * Used to prompt the user to press any key to continue.
  */
-void waitForInput() {
+void waitForInput(InputReader& input) {
     char lastChar = ' ';
-    while (!is_in(lastChar, 'w', 'a', 's', 'd')) cin >> lastChar;
+    while (!is_in(lastChar, 'w', 'a', 's', 'd', InputEvent::END_OF_INPUT)) lastChar = input.next().key;
 }
 
 
@@ -91,12 +92,12 @@ bool tryWalk(World& world, Player& player, bool left) {
     BlockPos neighbourPosTorso = playerPos+(left ? BlockPos(-1, 0) : BlockPos(1, 0));
     BlockPos neighbourPosFeet = playerPos+(left ? BlockPos(-1, 1) : BlockPos(1, 1));
     tryPushBlock(neighbourPosFeet, world, left);
-    if (!world.getBlockAt(neighbourPosFeet).getSettings().hasCollision()) {
+    if (!world.getSettingsAt(neighbourPosFeet).hasCollision()) {
         player.setPos(neighbourPosTorso);
         tryBlockGravity(playerPos, world);
         return true;
     }
-    else if (world.getBlockAt(neighbourPosFeet).getSettings().hasCollision() && !world.getBlockAt(neighbourPosTorso).getSettings().isSolid()) {
+    else if (world.getSettingsAt(neighbourPosFeet).hasCollision() && !world.getSettingsAt(neighbourPosTorso).isSolid()) {
         left ? player.move(-1, -1) : player.move(1, -1);
         return true;
     }
@@ -115,7 +116,7 @@ bool tryWalk(World& world, Player& player, bool left) {
  * @return true if the player's position was successfully updated, false otherwise.
  */
 bool tryGoDown(World& world, Player& player) {
-    if (world.getBlockAt(player.getPos()+BlockPos(0, 2)).getSettings().isClimbableFromTop() || world.getBlockAt(player.getPos()+BlockPos(0, 3)).getSettings().isClimbableFromTop()) {
+    if (world.getSettingsAt(player.getPos()+BlockPos(0, 2)).isClimbableFromTop() || world.getSettingsAt(player.getPos()+BlockPos(0, 3)).isClimbableFromTop()) {
         player.move(0, 1);
         return true;
     }
@@ -134,7 +135,7 @@ bool tryGoDown(World& world, Player& player) {
  * @return true if the player's position was successfully updated, false otherwise.
  */
 bool tryGoUp(World& world, Player& player) {
-    if (world.getBlockAt(player.getPos()+BlockPos(0, 1)).getSettings().isClimbableFromBottom() || world.getBlockAt(player.getPos()+BlockPos(0, 2)).getSettings().isClimbableFromBottom()) {
+    if (world.getSettingsAt(player.getPos()+BlockPos(0, 1)).isClimbableFromBottom() || world.getSettingsAt(player.getPos()+BlockPos(0, 2)).isClimbableFromBottom()) {
         player.move(0, -1);
         return true;
     }
@@ -155,8 +156,8 @@ bool tryGoUp(World& world, Player& player) {
  */
 void tryPushBlock(BlockPos& blockPos, World& world, bool left) {
     BlockPos neighbourBlockPos = blockPos+(left ? BlockPos(-1, 0) : BlockPos(1, 0));
-    if (world.getBlockAt(blockPos).getSettings().isPushable()) { 
-        if (world.getBlockAt(neighbourBlockPos).getSettings().isPushable()) {
+    if (world.getSettingsAt(blockPos).isPushable()) { 
+        if (world.getSettingsAt(neighbourBlockPos).isPushable()) {
             tryPushBlock(neighbourBlockPos, world, left); // If multiple boxes are next to each other, handle the furthest one first
         }
         if (world.getBlockAt(neighbourBlockPos) == world.getBlockRegistry().AIR) { // Push the box by swapping the blocks
@@ -168,44 +169,24 @@ void tryPushBlock(BlockPos& blockPos, World& world, bool left) {
 
 /**
  * Checks if the block below the player's feet has gravity and if so,
- * moves it down one block if possible.
+ * lets it fall down, in case there is AIR below it.
+ * This makes sand collapse after the player walked over it. The block falls as far as World::settle lets it,
+ * so it is moved instead of copied.
+ * On the bottom row, the block falls out of the world instead: the world grows by one row and the block moves there,
+ * leaving a hole behind.
  *
  * @param playerPos The position of the player.
  * @param world Reference to the World object representing the current world.
  */
 void tryBlockGravity(BlockPos& playerPos, World& world) {
-    if (world.getBlockAt(playerPos.add(0, 2)).getSettings().hasGravity() && world.getBlockAt(playerPos.add(0, 3)) == world.getBlockRegistry().AIR) {
-        world.setBlockAt(playerPos.add(0, 3), world.getBlockAt(playerPos.add(0, 2)));
-        world.setBlockAt(playerPos.add(0, 2), world.getBlockRegistry().AIR);
+    BlockPos blockPos = playerPos.add(0, 2);
+    BlockPos below = playerPos.add(0, 3);
+    if (!world.getSettingsAt(blockPos).hasGravity() || world.getBlockAt(below) != world.getBlockRegistry().AIR) return;
+    if (!world.containsPos(below)) {
+        world.placeBlockAt(below, world.getBlockAt(blockPos));
+        world.setBlockAt(blockPos, world.getBlockRegistry().AIR);
+        return;
     }
-}
-
-/**
- * Listens for the player's input and updates the game state accordingly.
- * If test mode is enabled, reads input from the file TEST.txt instead of the console.
- * In this case, the game state is updated every 100 milliseconds (to simulate the player's input).
- * If the player dies or reaches the goal, exit the loop.
- */
-void inputLoop(Player& player, World& world, bool testMode, unsigned int worldIndex) {
-    vector<string> testFile = readFileAsVector("TEST.txt");
-    unsigned int inputIndex = 0;
-    while (player.isAlive() && !player.hasReachedGoal()) {
-        string currentInput;
-        if (testMode) {
-            currentInput = testFile[worldIndex][inputIndex];
-            inputIndex++;
-            if (inputIndex > testFile[worldIndex].length()) break;
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-        else cin >> currentInput;
-        if (!testMode) {
-            jumpBackOneLine();
-        }
-
-        for (char lastChar : currentInput) {
-            if (onInput(lastChar, world, player))
-                redraw(world, player.mapToWorldspace());
-        }
-    }
-    inputIndex = 0;
+    world.scheduleUpdate(blockPos);
+    world.settle();
 }
\ No newline at end of file
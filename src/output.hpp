@@ -1,8 +1,15 @@
 #pragma once
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include "world.hpp"
+#include "trace.hpp"
 
 using std::string;
 using std::cout;
@@ -17,48 +24,357 @@ void jumpBackOneLine() {
 }
 
 /**
- * Renders the current state of the game world and player onto the console.
- * It prints the world's blocks with their respective colors and encodings (characters).
- * On positions that overlap with the player texture, the relevant character of the player's texture is printed instead.
- * 
- * @param world Reference to the World object representing the current world.
- * @param player Reference to the Player object representing the player's state.
+ * A 3x3 texture, centered on the position it is drawn at.
  */
-void render(World &world, vector<vector<char>> playerTexture) {
-    vector<vector<Block>> canvas = world.getFieldState();
-     
-
-    for (unsigned int y = 0; y <= world.getMaxY(); y++) {
-        for (unsigned int x = 0; x <= world.getMaxX(); x++) {
-            if (!world.getBlockAt(BlockPos(x, y)).getSettings().isPushable() 
-                && playerTexture.size() > y && playerTexture.at(y).size() > x && playerTexture.at(y).at(x) != ' ') {
-                cout << Color::BRIGHT_YELLOW << playerTexture.at(y).at(x);
-            }
-            else if (canvas.size() > y && canvas.at(y).size() > x) {
-                cout << canvas.at(y).at(x).getColor() << canvas.at(y).at(x).getEncoding();
-            }
-            else cout << ' ';
-        }
-        cout << endl;
+using Texture = std::array<std::array<char, 3>, 3>;
+
+/**
+ * Something that is drawn on top of the world, like the player.
+ */
+struct Sprite {
+    BlockPos pos;
+    const Texture& texture;
+
+    /**
+     * @return The character of the texture at the given world position, or ' ' if the texture does not cover it.
+     */
+    char getCharAt(unsigned int x, unsigned int y) const {
+        int xOffset = static_cast<int>(x) - pos.getX() + 1;
+        int yOffset = static_cast<int>(y) - pos.getY() + 1;
+        if (xOffset < 0 || xOffset > 2 || yOffset < 0 || yOffset > 2) return ' ';
+        return texture[yOffset][xOffset];
     }
-}
+};
 
 /**
- * Redraws the game world and player state on the console.
- * This function first moves the console cursor up by the number of lines
- * equivalent to the world's height, effectively clearing previous output.
- * It then calls the render function to display the current state of the world
- * and the player.
+ * Draws the world and the player onto the console.
  *
- * @param world Reference to the World object representing the current world.
- * @param player Reference to the Player object representing the player's state.
+ * Only a window of the world the size of the console (the viewport) is drawn. The camera follows the player,
+ * keeping a margin between the player and the edges of the viewport where possible.
+ * When the camera moves, the content that is already on screen is shifted using the console's scrolling
+ * and character insert/delete codes, so only the newly visible strips have to be drawn.
+ *
+ * The renderer remembers what is currently visible on screen. After the first full frame,
+ * only cells that were marked as dirty by the World or Player and actually look different are drawn again.
+ * Changed cells are addressed with absolute cursor positions, color codes are only sent when the color changes,
+ * and every frame is written to the console in a single write.
  */
-void redraw(World &world, vector<vector<char>> playerTexture) {
-    for (unsigned int y = 0; y <= world.getMaxY(); y++) {
-        jumpBackOneLine();
+class Renderer {
+public:
+    /**
+     * @param out The stream to draw to. If it is a terminal, the viewport is sized to fit it, otherwise the whole world is drawn.
+     */
+    Renderer(std::ostream& out = cout) : out(out) {}
+
+    /**
+     * Limit the viewport to the given size, instead of the size of the terminal.
+     * The last line of the viewport is left free for the player's input.
+     * 
+     * @param columns The maximum amount of columns to draw.
+     * @param rows The maximum amount of rows to use, including the input line.
+     */
+    void setViewport(unsigned int columns, unsigned int rows) {
+        fixedColumns = columns;
+        fixedRows = rows;
     }
-    render(world, playerTexture);
-}
+
+    /**
+     * Set how close the player can get to the edges of the viewport before the camera moves.
+     * 
+     * @param horizontal Minimum amount of columns between the player and the left/right edge.
+     * @param vertical Minimum amount of rows between the player and the top/bottom edge.
+     */
+    void setMargins(unsigned int horizontal, unsigned int vertical) {
+        marginX = horizontal;
+        marginY = vertical;
+    }
+
+    /**
+     * @return The world position that is shown in the top left corner of the viewport.
+     */
+    BlockPos getCameraPos() {
+        return BlockPos(cameraX, cameraY);
+    }
+
+    /**
+     * Clears the console and draws everything inside of the viewport.
+     * On positions that overlap with the player texture, the relevant character of the player's texture is printed instead.
+     * 
+     * @param world Reference to the World object representing the current world.
+     * @param player The player's sprite.
+     */
+    void render(World &world, const Sprite& player) {
+        TraceSpan span("render");
+        worldWidth = world.getMaxX() + 1;
+        worldHeight = world.getMaxY() + 1;
+        updateViewportSize();
+        screen.assign(viewWidth * viewHeight, Cell());
+        followPlayer(player);
+        frame.clear();
+        frame += "\033[2J\033[H";
+        beginFrame();
+        cursorKnown = true; // The cursor is in the top left corner after clearing the console
+        drawArea(world, player, 0, 0, viewWidth, viewHeight);
+        endFrame(world);
+    }
+
+    /**
+     * Draws all cells that changed since the last frame, after moving the camera if needed.
+     * Falls back to a full render if the size of the world or the console changed.
+     * 
+     * @param world Reference to the World object representing the current world.
+     * @param player The player's sprite.
+     */
+    void redraw(World &world, const Sprite& player) {
+        unsigned int previousWidth = viewWidth;
+        unsigned int previousHeight = viewHeight;
+        updateViewportSize();
+        if (worldWidth != world.getMaxX() + 1 || worldHeight != world.getMaxY() + 1 || previousWidth != viewWidth || previousHeight != viewHeight) {
+            render(world, player);
+            return;
+        }
+        TraceSpan span("redraw");
+        frame.clear();
+        beginFrame();
+
+        int previousX = cameraX;
+        int previousY = cameraY;
+        followPlayer(player);
+        int shiftX = static_cast<int>(cameraX) - previousX;
+        int shiftY = static_cast<int>(cameraY) - previousY;
+        if (std::abs(shiftX) >= static_cast<int>(viewWidth) || std::abs(shiftY) >= static_cast<int>(viewHeight)) {
+            // Nothing on screen can be reused
+            std::fill(screen.begin(), screen.end(), Cell());
+            drawArea(world, player, 0, 0, viewWidth, viewHeight);
+        }
+        else {
+            if (shiftY != 0) scrollVertically(shiftY);
+            if (shiftX != 0) scrollHorizontally(shiftX);
+            // Draw the strips that just became visible
+            if (shiftY > 0) drawArea(world, player, 0, viewHeight - shiftY, viewWidth, viewHeight);
+            if (shiftY < 0) drawArea(world, player, 0, 0, viewWidth, -shiftY);
+            if (shiftX > 0) drawArea(world, player, viewWidth - shiftX, 0, viewWidth, viewHeight);
+            if (shiftX < 0) drawArea(world, player, 0, 0, -shiftX, viewHeight);
+        }
+
+        vector<BlockPos>& dirtyCells = world.getDirtyCells();
+        // Draw in reading order, so that neighbouring cells can be written without moving the cursor in between
+        std::sort(dirtyCells.begin(), dirtyCells.end(), [](BlockPos a, BlockPos b) {
+            return a.getY() < b.getY() || (a.getY() == b.getY() && a.getX() < b.getX());
+        });
+        for (BlockPos pos : dirtyCells) {
+            unsigned int x = pos.getUnsignedX() - cameraX;
+            unsigned int y = pos.getUnsignedY() - cameraY;
+            if (x < viewWidth && y < viewHeight) drawCell(world, player, x, y);
+        }
+        endFrame(world);
+    }
+
+    /**
+     * @return The total amount of bytes written to the console by this renderer.
+     */
+    unsigned long getBytesWritten() {
+        return bytesWritten;
+    }
+
+private:
+    struct Cell {
+        char encoding = 0; // 0 is never drawn, so that every cell differs before the first frame
+        Color color = Color::RESET;
+        bool operator==(const Cell& other) const {
+            return encoding == other.encoding && color == other.color;
+        }
+    };
+
+    std::ostream& out;
+    // What is currently visible inside of the viewport, row by row
+    vector<Cell> screen;
+    unsigned int worldWidth = 0;
+    unsigned int worldHeight = 0;
+    // A fixed viewport size set with setViewport, 0 to use the size of the terminal
+    unsigned int fixedColumns = 0;
+    unsigned int fixedRows = 0;
+    unsigned int viewWidth = 0;
+    unsigned int viewHeight = 0;
+    // The world position shown in the top left corner of the viewport
+    unsigned int cameraX = 0;
+    unsigned int cameraY = 0;
+    unsigned int marginX = 10;
+    unsigned int marginY = 3;
+    // The frame that is currently being assembled
+    string frame;
+    // Where the console's cursor will be after the frame that is being assembled so far
+    unsigned int cursorX = 0;
+    unsigned int cursorY = 0;
+    bool cursorKnown = false;
+    bool colorKnown = false;
+    Color currentColor = Color::RESET;
+    unsigned long bytesWritten = 0;
+
+    void beginFrame() {
+        colorKnown = false;
+        cursorKnown = false;
+    }
+
+    /**
+     * Moves the cursor below the viewport, so that the player's input is written there, and writes the frame.
+     */
+    void endFrame(World &world) {
+        moveCursor(0, viewHeight);
+        frame += "\033[2K";
+        setColor(Color::RESET);
+        out.write(frame.data(), frame.size());
+        out.flush();
+        bytesWritten += frame.size();
+        Tracer::count(TraceCounter::BYTES_RENDERED, frame.size());
+        Tracer::sampleCounters();
+        world.clearDirtyCells();
+    }
+
+    /**
+     * Calculates how much of the world fits into the viewport.
+     * Uses the size of the terminal if the renderer draws to one, leaving the last line for the player's input.
+     */
+    void updateViewportSize() {
+        unsigned int columns = fixedColumns;
+        unsigned int rows = fixedRows;
+        winsize terminalSize;
+        if (columns == 0 && rows == 0 && &out == &cout && isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminalSize) == 0) {
+            columns = terminalSize.ws_col;
+            rows = terminalSize.ws_row;
+        }
+        viewWidth = columns == 0 ? worldWidth : std::min(worldWidth, columns);
+        viewHeight = rows <= 1 ? worldHeight : std::min(worldHeight, rows - 1);
+    }
+
+    /**
+     * Moves the camera, so that the player keeps the configured distance to the edges of the viewport.
+     * The camera never shows anything outside of the world.
+     */
+    void followPlayer(const Sprite& player) {
+        cameraX = followAxis(cameraX, player.pos.getX(), marginX, viewWidth, worldWidth);
+        cameraY = followAxis(cameraY, player.pos.getY(), marginY, viewHeight, worldHeight);
+    }
+
+    static unsigned int followAxis(int camera, int target, unsigned int margin, unsigned int viewSize, unsigned int worldSize) {
+        if (viewSize == 0) return 0;
+        int usableMargin = std::min(margin, (viewSize - 1) / 2);
+        if (target - camera < usableMargin) camera = target - usableMargin;
+        if (target - camera > static_cast<int>(viewSize) - 1 - usableMargin) camera = target - static_cast<int>(viewSize) + 1 + usableMargin;
+        return std::clamp(camera, 0, static_cast<int>(worldSize - viewSize));
+    }
+
+    /**
+     * Shifts everything inside of the viewport up (positive shift) or down (negative shift) by using a scrolling region.
+     */
+    void scrollVertically(int shift) {
+        frame += "\033[1;";
+        appendNumber(viewHeight);
+        frame += 'r';
+        frame += "\033[";
+        appendNumber(std::abs(shift));
+        frame += shift > 0 ? 'S' : 'T';
+        frame += "\033[r";
+        cursorKnown = false; // Setting the scrolling region moves the cursor
+
+        size_t rowsMoved = (viewHeight - std::abs(shift)) * viewWidth;
+        if (shift > 0) std::move(screen.begin() + shift * viewWidth, screen.end(), screen.begin());
+        else std::move_backward(screen.begin(), screen.begin() + rowsMoved, screen.end());
+        auto exposed = shift > 0 ? screen.begin() + rowsMoved : screen.begin();
+        std::fill(exposed, exposed + std::abs(shift) * viewWidth, Cell());
+    }
+
+    /**
+     * Shifts everything inside of the viewport left (positive shift) or right (negative shift)
+     * by deleting or inserting characters at the start of each row.
+     */
+    void scrollHorizontally(int shift) {
+        unsigned int amount = std::abs(shift);
+        for (unsigned int y = 0; y < viewHeight; y++) {
+            moveCursor(0, y);
+            frame += "\033[";
+            appendNumber(amount);
+            frame += shift > 0 ? 'P' : '@';
+
+            auto row = screen.begin() + y * viewWidth;
+            if (shift > 0) std::move(row + amount, row + viewWidth, row);
+            else std::move_backward(row, row + viewWidth - amount, row + viewWidth);
+            auto exposed = shift > 0 ? row + viewWidth - amount : row;
+            std::fill(exposed, exposed + amount, Cell());
+        }
+    }
+
+    /**
+     * Draws all cells inside of the given rectangle of the viewport.
+     */
+    void drawArea(World &world, const Sprite& player, unsigned int fromX, unsigned int fromY, unsigned int toX, unsigned int toY) {
+        for (unsigned int y = fromY; y < toY; y++) {
+            for (unsigned int x = fromX; x < toX; x++) {
+                drawCell(world, player, x, y);
+            }
+        }
+    }
+
+    /**
+     * Adds the cell at the given position of the viewport to the frame, if it looks different from what is currently on screen.
+     */
+    void drawCell(World &world, const Sprite& player, unsigned int x, unsigned int y) {
+        BlockPos pos = BlockPos(cameraX + x, cameraY + y);
+        char playerChar = player.getCharAt(pos.getUnsignedX(), pos.getUnsignedY());
+        Cell cell;
+        if (playerChar != ' ' && !world.getSettingsAt(pos).isPushable()) {
+            cell = {playerChar, Color::BRIGHT_YELLOW};
+        }
+        else {
+            const Block& block = world.getBlockAt(pos);
+            cell = {block.getEncoding(), block.getColor()};
+        }
+
+        Cell& visible = screen[y * viewWidth + x];
+        if (visible == cell) return;
+        visible = cell;
+
+        moveCursor(x, y);
+        setColor(cell.color);
+        frame += cell.encoding;
+        cursorX++;
+    }
+
+    void moveCursor(unsigned int x, unsigned int y) {
+        if (cursorKnown && x == cursorX && y == cursorY) return;
+        if (cursorKnown && x == 0 && y == cursorY + 1) frame += "\r\n"; // Continue on the next line
+        else {
+            frame += "\033[";
+            appendNumber(y + 1);
+            frame += ';';
+            appendNumber(x + 1);
+            frame += 'H';
+        }
+        cursorX = x;
+        cursorY = y;
+        cursorKnown = true;
+    }
+
+    void setColor(Color color) {
+        if (colorKnown && color == currentColor) return;
+        frame += "\033[";
+        appendNumber(static_cast<unsigned int>(color));
+        frame += 'm';
+        currentColor = color;
+        colorKnown = true;
+    }
+
+    void appendNumber(unsigned int number) {
+        char digits[10];
+        unsigned int length = 0;
+        do {
+            digits[length++] = '0' + number % 10;
+            number /= 10;
+        } while (number > 0);
+        while (length > 0) frame += digits[--length];
+    }
+};
+
 
 /**
  * Prints a guide for the player, explaining what each block in the game
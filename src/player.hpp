@@ -1,16 +1,49 @@
 #pragma once
 #include <array>
-#include <thread>
-#include <chrono>
+#include <algorithm>
 
 #include "blockPos.hpp"
 #include "output.hpp"
+#include "trace.hpp"
+
+/**
+ * The outcome of a fall, found by scanning the column below the player once (see Player::scanFall).
+ */
+struct Fall {
+    // Amount of rows the player moves down
+    unsigned int rows = 0;
+    // Amount of steps in free fall, one more than rows if the player falls out of the world
+    unsigned int steps = 0;
+    // The player's fall length afterwards: 0 after landing, as water resets it
+    int fallLength = 0;
+    bool reachedGoal = false;
+    bool alive = true;
+    // Whether the player is still in free fall afterwards, which only happens when falling out of the world
+    bool freeFalling = false;
+    // Whether the player shows the falling texture afterwards
+    bool fallingTexture = false;
+};
 
 class Player {
 public:
+    /**
+     * Everything that changes while the player moves, so that a move can be undone.
+     */
+    struct State {
+        BlockPos pos = BlockPos(0, 0);
+        bool alive = true;
+        bool isFreeFalling = false;
+        bool reachedGoal = false;
+        int fallLength = 0;
+        bool falling = false;
+        unsigned int fallTicksLeft = 0;
+        unsigned int fallenRows = 0;
+        Fall pendingFall = {};
+        bool fallingTexture = false;
+    };
+
     Player(BlockPos pos, World& world) : world(world) {
         this->pos = pos;
-        this->world = world;
         playerTexture = REGULAR_PLAYER_TEXTURE;
     }
     
@@ -23,32 +56,97 @@ public:
     void move(BlockPos offset) {
         setPos(pos + offset);
     }
+    /**
+     * Move the player to the given position and let them fall, if there is nothing solid below their feet.
+     * The whole fall is resolved by a single scan of the column below (see scanFall), so falls of any height are cheap.
+     * If the fall is animated (see setTickRate), the player only moves down as tick() is called, and the outcome
+     * of the fall is applied once they arrive.
+     */
     void setPos(BlockPos pos) {
         if (!world.containsPos(pos)) {
             alive = false;
             return;
         }
-        this->pos = pos;
-
-        if (world.getBlockAt(pos) == world.getBlockRegistry().GOAL) reachedGoal = true;
-
-        if (world.getBlockAt(pos.add(0, 2)) == world.getBlockRegistry().WATER) fallLength = 0;
-
-        isFreeFalling = !world.getBlockAt(pos.add(0, 2)).getSettings().isSolid();
-        if (isFreeFalling) {
-            fallLength += 1;
-            if (fallLength > 2) playerTexture = FALLING_PLAYER_TEXTURE;
-            redraw(world, this->mapToWorldspace());
-            std::this_thread::sleep_for(std::chrono::milliseconds(100 / fallLength + 50));
-            move(0, 1);
+        Tracer::Clock::time_point start = Tracer::isEnabled() ? Tracer::Clock::now() : Tracer::Clock::time_point();
+        place(pos);
+        Fall fall = scanFall(pos);
+        Tracer::count(TraceCounter::FALL_STEPS, fall.steps);
+        if (tickRate > 0 && fall.rows > 0) { // Only animate the fall if someone is watching
+            fallStart = start;
+            pendingFall = fall;
+            fallenRows = 0;
+            startFallStep();
+            return;
         }
-        else {
-            if (fallLength > 5) alive = false;
-            fallLength = 0;
-            playerTexture = REGULAR_PLAYER_TEXTURE;
+        if (fall.rows > 0) place(pos.add(0, fall.rows));
+        land(fall);
+        if (fall.steps > 0 && Tracer::isEnabled()) Tracer::recordSpan("fall", {}, start, Tracer::Clock::now());
+    }
+    /**
+     * Find out where a fall from the given position ends and how it ends, without moving the player.
+     * The column below is scanned once, applying the same rules as if the player moved down one block at a time:
+     * passing the goal counts as reaching it, water below the feet resets the fall length,
+     * landing after falling more than 5 blocks or on a lethal block kills, and so does falling out of the world.
+     *
+     * @param from The position the fall starts at, with the player's current fall length.
+     * @return The outcome of the fall. Has 0 rows if the player stands on something solid.
+     */
+    Fall scanFall(BlockPos from) {
+        const BlockRegistry& registry = world.getBlockRegistry();
+        Fall fall = {0, 0, fallLength, false, true, false, playerTexture == FALLING_PLAYER_TEXTURE};
+        for (BlockPos current = from;; current = current.add(0, 1)) {
+            if (world.getBlockAt(current) == registry.GOAL) fall.reachedGoal = true;
+            const Block& below = world.getBlockAt(current.add(0, 2));
+            if (below == registry.WATER) fall.fallLength = 0;
+            if (below.getSettings().isLethal()) fall.alive = false;
+            if (below.getSettings().isSolid()) {
+                if (fall.fallLength > 5) fall.alive = false;
+                fall.fallLength = 0;
+                fall.fallingTexture = false;
+                return fall;
+            }
+            fall.steps++;
+            fall.fallLength++;
+            if (fall.fallLength > 2) fall.fallingTexture = true;
+            if (!world.containsPos(current.add(0, 1))) {
+                fall.alive = false;
+                fall.freeFalling = true;
+                return fall;
+            }
+            fall.rows++;
         }
-
-        if (world.getBlockAt(pos.add(0, 2)).getSettings().isLethal()) alive = false;
+    }
+    /**
+     * Animate falls in game ticks instead of resolving them instantly.
+     * While falling, the player moves down one block each time tick() was called often enough.
+     * 
+     * @param tickRate The amount of ticks per second, or 0 to resolve falls instantly (the default).
+     */
+    void setTickRate(unsigned int tickRate) {
+        this->tickRate = tickRate;
+    }
+    /**
+     * Advance a running fall by one tick.
+     * The longer the fall, the fewer ticks it takes until the next block, so that the player appears to speed up.
+     */
+    void tick() {
+        if (!falling || --fallTicksLeft > 0) return;
+        place(pos.add(0, 1));
+        fallenRows++;
+        if (fallenRows >= 2) playerTexture = FALLING_PLAYER_TEXTURE; // The step off the edge counts as the first block of the fall
+        if (fallenRows < pendingFall.rows) {
+            startFallStep();
+            return;
+        }
+        falling = false;
+        land(pendingFall);
+        if (Tracer::isEnabled()) Tracer::recordSpan("fall", {}, fallStart, Tracer::Clock::now());
+    }
+    /**
+     * @return Whether the player is in the middle of an animated fall. No other moves should be made until it is over.
+     */
+    bool isFalling() {
+        return falling;
     }
     bool isAlive() {
         return alive;
@@ -56,47 +154,111 @@ public:
     bool hasReachedGoal() {
         return reachedGoal;
     }
-    vector<vector<char>> mapToWorldspace() {
-        vector<vector<char>> map;
-        for (unsigned int y = 0; y <= world.getMaxY(); y++) {
-            for (unsigned int x = 0; x <= world.getMaxX(); x++) {
-                while (map.size() <= y) map.push_back({});
-                while (map[y].size() <= x) map[y].push_back(' ');
-
-                int yOffset = y-pos.getY() + 1;
-                int xOffset = x-pos.getX() + 1;
-
-                char encoding = ' ';
-                if (yOffset >= 0 && yOffset < static_cast<int>(playerTexture.size()) && 
-                xOffset >= 0 && xOffset < static_cast<int>(playerTexture.at(yOffset).size())) {
-                    encoding = playerTexture.at(yOffset).at(xOffset);
-                }
-                    
-                map[y][x] = encoding;
-            }
-        }
-        return map;
+    /**
+     * Get a hash of the whole game state: every block of the world (see World::getFieldHash),
+     * the player's position and fall length and whether they are alive or reached the goal.
+     * Two games that behave the same have the same hash after every move.
+     * 
+     * @return The hash of the current game state.
+     */
+    uint64_t getStateHash() {
+        return world.getFieldHash() ^ hashPlayer(pos, fallLength, alive, reachedGoal);
+    }
+    /**
+     * @return The current state of the player, to be restored with setState.
+     */
+    State getState() {
+        return {pos, alive, isFreeFalling, reachedGoal, fallLength, falling, fallTicksLeft, fallenRows, pendingFall, playerTexture == FALLING_PLAYER_TEXTURE};
+    }
+    /**
+     * Put the player back into a state returned by getState, without checking the world around it.
+     */
+    void setState(const State& state) {
+        markDirty();
+        pos = state.pos;
+        alive = state.alive;
+        isFreeFalling = state.isFreeFalling;
+        reachedGoal = state.reachedGoal;
+        fallLength = state.fallLength;
+        falling = state.falling;
+        fallTicksLeft = state.fallTicksLeft;
+        fallenRows = state.fallenRows;
+        pendingFall = state.pendingFall;
+        playerTexture = state.fallingTexture ? FALLING_PLAYER_TEXTURE : REGULAR_PLAYER_TEXTURE;
+        markDirty();
+    }
+    /**
+     * @return The player's current texture at the player's position, to be drawn on top of the world.
+     */
+    Sprite getSprite() {
+        return {pos, playerTexture};
     }
 
 private:
     World& world;
-    std::array<std::array<char, 3>, 3> playerTexture;
+    // Ticks per second of the game loop, 0 if falls are not animated
+    unsigned int tickRate = 0;
+    unsigned int fallTicksLeft = 0;
+    bool falling = false;
+    // The animated fall that is running, and how many of its rows the player has moved down so far
+    Fall pendingFall;
+    unsigned int fallenRows = 0;
+    // When the current animated fall started, only set while tracing
+    Tracer::Clock::time_point fallStart;
+    Texture playerTexture;
     BlockPos pos = BlockPos(0, 0);
     bool alive = true;
     bool isFreeFalling = false;
     bool reachedGoal = false;
     int fallLength = 0;
 
-    const std::array<std::array<char, 3>, 3> REGULAR_PLAYER_TEXTURE {{
+    const Texture REGULAR_PLAYER_TEXTURE {{
         {' ', 'o', ' '},
         {'/', '|', '\\'},
         {'/', ' ', '\\'}
         }       // Player pos is at the center '|' char
     };
-    const std::array<std::array<char, 3>, 3> FALLING_PLAYER_TEXTURE {{
+    const Texture FALLING_PLAYER_TEXTURE {{
         {'\\', 'o', '/'},
         {' ', '|', ' '},
         {'/', ' ', '\\'}
         }       // Player pos is at the center '|' char
     };
+
+    /**
+     * Wait before falling down the next block: 100 / (blocks fallen + 1) + 50 milliseconds, converted to ticks.
+     */
+    void startFallStep() {
+        falling = true;
+        fallTicksLeft = std::max(1u, (100 / (fallenRows + 1) + 50) * tickRate / 1000);
+    }
+
+    /**
+     * Move the player to the given position, without checking the world around it.
+     */
+    void place(BlockPos pos) {
+        markDirty();
+        this->pos = pos;
+        markDirty();
+    }
+
+    /**
+     * Apply the outcome of a fall, once the player has arrived at its end.
+     */
+    void land(const Fall& fall) {
+        if (fall.reachedGoal) reachedGoal = true;
+        if (!fall.alive) alive = false;
+        fallLength = fall.fallLength;
+        isFreeFalling = fall.freeFalling;
+        playerTexture = fall.fallingTexture ? FALLING_PLAYER_TEXTURE : REGULAR_PLAYER_TEXTURE;
+    }
+
+    /**
+     * Marks the cells covered by the player's texture as changed, so that they are drawn again in the next frame.
+     */
+    void markDirty() {
+        for (int y = -1; y <= 1; y++)
+            for (int x = -1; x <= 1; x++)
+                world.markDirty(pos.add(x, y));
+    }
 };
\ No newline at end of file
@@ -0,0 +1,694 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <unordered_map>
+#include <iostream>
+#include <streambuf>
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "output.hpp"
+#include "input.hpp"
+#include "gameLoop.hpp"
+#include "history.hpp"
+#include "levelPack.hpp"
+#include "fileutils.hpp"
+#include "movementHandler.hpp"
+
+using std::string;
+using std::vector;
+
+struct ServerSettings {
+    // Amount of worker threads that run the sessions, 0 uses all cores
+    unsigned int threads = 0;
+    LoopSettings loop;
+    // Size of the viewport every session is drawn in, including the input line
+    unsigned int columns = 80;
+    unsigned int rows = 24;
+    // Output a client has not received yet, beyond which frames are dropped until it caught up
+    size_t maxPendingOutput = 64 * 1024;
+    // How many moves each session can undo, History::UNLIMITED for all of them.
+    // A limit bounds the memory of long sessions. Players are told about it once it made them lose a move (see Session::endLevel)
+    size_t maxUndo = History::UNLIMITED;
+    // Connections beyond this amount of sessions are closed right away
+    unsigned int maxSessions = 10000;
+};
+
+/**
+ * Collects the output of a session until the socket can take it.
+ * Line breaks are sent as "\r\n", as the terminal of the client is usually in raw mode.
+ * Once more than the limit is pending, further output is dropped and the buffer is marked as overflowed,
+ * unless the limit is lifted, e.g. to draw the whole screen again once the client caught up.
+ */
+class SessionOutput : public std::streambuf {
+public:
+    SessionOutput(size_t limit) : limit(limit) {}
+
+    /**
+     * Send as much of the pending output as the socket takes without blocking.
+     *
+     * @return False if the connection failed.
+     */
+    bool send(int fd) {
+        while (sent < pending.size()) {
+            ssize_t count = ::send(fd, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                // Keep the buffer from growing at the front while the client is slow
+                if (sent > pending.size() / 2) {
+                    pending.erase(0, sent);
+                    sent = 0;
+                }
+                return true;
+            }
+            sent += count;
+            bytesSent += count;
+        }
+        pending.clear();
+        sent = 0;
+        return true;
+    }
+
+    bool isEmpty() {
+        return sent == pending.size();
+    }
+
+    /**
+     * @return Whether output was dropped since the last call. The screen has to be drawn from scratch then.
+     */
+    bool takeOverflow() {
+        bool result = overflowed;
+        overflowed = false;
+        return result;
+    }
+
+    unsigned long getBytesSent() {
+        return bytesSent;
+    }
+
+    void setLimited(bool limited) {
+        this->limited = limited;
+    }
+
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) append(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+        for (std::streamsize i = 0; i < count; i++) append(data[i]);
+        return count;
+    }
+
+private:
+    size_t limit;
+    string pending;
+    // How much of pending was already sent
+    size_t sent = 0;
+    bool overflowed = false;
+    bool limited = true;
+    unsigned long bytesSent = 0;
+
+    void append(char c) {
+        if (limited && pending.size() - sent >= limit) {
+            overflowed = true;
+            return;
+        }
+        if (c == '\n') pending += '\r';
+        pending += c;
+    }
+};
+
+/**
+ * One client of the server, playing through all levels in order, just like a player of the local game.
+ * Every session has its own world, player, history and renderer, and takes its keys from its connection.
+ *
+ * A session never blocks: update() takes the keys that arrived, runs the ticks that are due and sends
+ * what can be sent. getNextUpdate() tells when it has to run again if no key arrives in the meantime.
+ */
+class Session : public KeySource {
+public:
+    using Clock = GameLoop::Clock;
+
+    /**
+     * How the Server schedules the session, see Server::schedule.
+     */
+    enum class Scheduling {
+        IDLE,
+        QUEUED,
+        RUNNING,
+        // Running, and has to run again right after, as something happened in the meantime
+        RUNNING_AGAIN,
+        FINISHED
+    };
+    std::atomic<Scheduling> scheduling = Scheduling::IDLE;
+    // Only the latest timer of the session is valid, older ones are skipped
+    std::atomic<unsigned long> timerGeneration = 0;
+
+    Session(uint64_t id, int fd, LevelPack& levels, const ServerSettings& settings)
+        : id(id), fd(fd), levels(levels), settings(settings), output(settings.maxPendingOutput), out(&output), renderer(out), loop(settings.loop) {
+        renderer.setViewport(settings.columns, settings.rows);
+        printFile("./screens/start.txt", Color::BRIGHT_YELLOW, out);
+    }
+    ~Session() {
+        close(fd);
+    }
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    uint64_t getId() {
+        return id;
+    }
+    int getFd() {
+        return fd;
+    }
+
+    /**
+     * Take the keys the client sent, advance the game and send the output.
+     *
+     * @return False once the session is over or the connection failed, so that it can be closed.
+     */
+    bool update() {
+        if (!readKeys()) return false;
+        switch (phase) {
+            case Phase::WELCOME: {
+                InputEvent event;
+                while (phase == Phase::WELCOME && poll(event))
+                    if (is_in(event.key, 'w', 'a', 's', 'd')) startLevel(0);
+                break;
+            }
+            case Phase::DEAD: {
+                InputEvent event;
+                if (!poll(event)) break;
+                if (!is_in(event.key, 'u', 'U', 'r', 'R')) {
+                    phase = Phase::OVER;
+                    break;
+                }
+                if (is_in(event.key, 'u', 'U')) history->undo();
+                else history->restart();
+                renderer.render(*world, player->getSprite());
+                loop.start(*player);
+                phase = Phase::PLAYING;
+                break;
+            }
+            default: break;
+        }
+        if (phase == Phase::PLAYING) {
+            if (idle) loop.resume();
+            if (!loop.update(*player, *world, renderer, this, "", *history)) endLevel();
+        }
+        if (!output.send(fd)) return false;
+        // Frames were dropped, draw everything again once the client caught up
+        if (output.isEmpty() && output.takeOverflow()) {
+            // A full frame always fits, even if it is larger than the limit
+            output.setLimited(false);
+            if (phase == Phase::PLAYING) renderer.render(*world, player->getSprite());
+            output.setLimited(true);
+            if (!output.send(fd)) return false;
+        }
+        return phase != Phase::OVER || !output.isEmpty();
+    }
+
+    /**
+     * @return When update() has to run again, unless the client sends keys or can take more output before.
+     *         Clock::time_point::max() if the session waits for the client.
+     */
+    Clock::time_point getNextUpdate() {
+        Clock::time_point next = Clock::time_point::max();
+        if (phase == Phase::PLAYING) next = loop.getNextUpdate(*player, *world, this);
+        idle = next == Clock::time_point::max();
+        // Keys that could not be taken yet, e.g. while falling, are taken in one of the next ticks
+        if (!keys.empty() || unreadKeys) next = std::min(next, Clock::now() + std::chrono::seconds(1) / settings.loop.tickRate);
+        return next;
+    }
+
+    bool poll(InputEvent& event) override {
+        if (keys.empty()) return false;
+        event = keys.front();
+        keys.pop_front();
+        return true;
+    }
+
+    void recordLatency(const InputEvent& event) override {
+        latency.record(event);
+    }
+
+    GameLoop& getLoop() {
+        return loop;
+    }
+    const LatencyStats& getLatency() {
+        return latency;
+    }
+    unsigned long getBytesSent() {
+        return output.getBytesSent();
+    }
+
+private:
+    enum class Phase {
+        // The start screen is shown, until a movement key is pressed
+        WELCOME,
+        PLAYING,
+        // The player died and is asked whether to undo or restart
+        DEAD,
+        // All levels are completed or the player gave up, the connection is closed once everything was sent
+        OVER
+    };
+    // Keys are only read from the socket while fewer than this are waiting, the client has to wait for the rest
+    static constexpr size_t MAX_PENDING_KEYS = 64;
+
+    uint64_t id;
+    int fd;
+    LevelPack& levels;
+    const ServerSettings& settings;
+    SessionOutput output;
+    std::ostream out;
+    Renderer renderer;
+    GameLoop loop;
+    LatencyStats latency;
+    Phase phase = Phase::WELCOME;
+    size_t level = 0;
+    std::unique_ptr<World> world;
+    std::unique_ptr<Player> player;
+    std::unique_ptr<History> history;
+    std::deque<InputEvent> keys;
+    // Whether the socket may still hold keys that did not fit into keys
+    bool unreadKeys = false;
+    // Whether the game waited for keys since the last update, so that the missed ticks are skipped
+    bool idle = false;
+
+    /**
+     * @return False if the client closed the connection or it failed.
+     */
+    bool readKeys() {
+        char buffer[MAX_PENDING_KEYS];
+        unreadKeys = false;
+        while (keys.size() < MAX_PENDING_KEYS) {
+            ssize_t count = recv(fd, buffer, MAX_PENDING_KEYS - keys.size(), MSG_DONTWAIT);
+            if (count == 0) return false;
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            auto time = Clock::now();
+            for (ssize_t i = 0; i < count; i++) keys.push_back({buffer[i], time});
+        }
+        unreadKeys = true;
+        return true;
+    }
+
+    void startLevel(size_t index) {
+        level = index;
+        history.reset();
+        player.reset();
+        world = std::make_unique<World>(levels.load(index));
+        player = std::make_unique<Player>(world->getStartPos(), *world);
+        history = std::make_unique<History>(*world, *player, settings.maxUndo);
+        renderer.render(*world, player->getSprite());
+        loop.start(*player);
+        idle = false;
+        phase = Phase::PLAYING;
+    }
+
+    void endLevel() {
+        if (player->hasReachedGoal()) {
+            if (level + 1 < levels.size()) startLevel(level + 1);
+            else {
+                printFile("./screens/victory.txt", Color::BRIGHT_GREEN, out);
+                phase = Phase::OVER;
+            }
+            return;
+        }
+        printFile("./screens/death.txt", Color::BRIGHT_RED, out);
+        printFile("./screens/retry.txt", Color::BRIGHT_YELLOW, out);
+        if (history->getForgottenMoves() > 0)
+            out << "Auf diesem Server können nur die letzten " << history->getMaxMoves() << " Schritte rückgängig gemacht werden, "
+                << history->getForgottenMoves() << " ältere Schritte sind vergessen." << endl;
+        keys.clear(); // Keys pressed before the question was shown are no answer to it
+        phase = Phase::DEAD;
+    }
+};
+
+/**
+ * Hosts many sessions in one process, on a Unix domain socket.
+ *
+ * The thread that calls run() waits for new connections, for clients that sent keys or can take more output
+ * and for sessions whose next tick is due, all with a single epoll instance. It does not run any session itself,
+ * but queues it on one of a fixed pool of worker threads.
+ * Every worker has its own queue. A worker that runs out of sessions steals them from the other queues,
+ * so a few busy sessions never hold up the idle ones queued behind them.
+ * A session is queued at most once and only ever runs on one worker at a time.
+ */
+class Server {
+public:
+    using Clock = Session::Clock;
+
+    Server(LevelPack& levels, ServerSettings settings) : levels(levels), settings(settings) {
+        if (this->settings.threads == 0) this->settings.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * Accept sessions on the given socket until SIGINT or SIGTERM is received.
+     *
+     * @return 0 after shutting down, 1 if the socket could not be opened.
+     */
+    int run(const string& socketPath) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            std::cerr << socketPath << ": path too long for a Unix socket" << std::endl;
+            return 1;
+        }
+        std::strcpy(address.sun_path, socketPath.c_str());
+        unlink(socketPath.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << socketPath << ": " << std::strerror(errno) << std::endl;
+            if (listenFd >= 0) close(listenFd);
+            return 1;
+        }
+        raiseFileLimit();
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        watch(listenFd, LISTEN_ID, EPOLLIN);
+        watch(wakeFd, WAKE_ID, EPOLLIN);
+        signalWakeFd = wakeFd;
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+
+        workers = vector<Worker>(settings.threads);
+        for (unsigned int i = 0; i < workers.size(); i++) workers[i].thread = std::thread([this, i]() { work(i); });
+        std::cerr << "Serving on " << socketPath << " with " << workers.size() << " worker threads" << std::endl;
+
+        std::array<epoll_event, 256> events;
+        while (!stopRequested) {
+            int ready = epoll_wait(epollFd, events.data(), events.size(), getTimeout());
+            for (int i = 0; i < ready; i++) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID) acceptSessions();
+                else if (id == WAKE_ID) {
+                    uint64_t count;
+                    (void)!read(wakeFd, &count, sizeof(count));
+                }
+                else if (auto session = sessions.find(id); session != sessions.end()) schedule(session->second, nextWorker++ % workers.size());
+            }
+            removeFinishedSessions();
+            scheduleDueTimers();
+        }
+
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (Worker& worker : workers) worker.thread.join();
+        for (auto& [id, session] : sessions) finish(*session);
+        sessions.clear();
+        close(listenFd);
+        close(epollFd);
+        close(wakeFd);
+        unlink(socketPath.c_str());
+        return 0;
+    }
+
+    /**
+     * Print how many sessions were served, how their game loops kept up and how long it took until keys were visible.
+     */
+    void printStats(std::ostream& out) {
+        std::lock_guard lock(statsMutex);
+        out << "Server: " << sessionCount << " sessions, at most " << peakSessions << " at once, " << rejectedCount << " rejected; "
+            << bytesSent << " bytes sent" << std::endl;
+        loopTotals.printStats(out);
+        latencyTotals.print(out);
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        // The worker takes sessions from the back, other workers steal from the front
+        std::deque<std::shared_ptr<Session>> queue;
+        std::thread thread;
+    };
+    struct Timer {
+        Clock::time_point time;
+        uint64_t id;
+        unsigned long generation;
+        bool operator>(const Timer& other) const {
+            return time > other.time;
+        }
+    };
+
+    // epoll ids of the listening socket and the wake-up event, sessions are numbered after them
+    static constexpr uint64_t LISTEN_ID = 0;
+    static constexpr uint64_t WAKE_ID = 1;
+    static inline std::atomic<bool> stopRequested = false;
+    static inline int signalWakeFd = -1;
+
+    LevelPack& levels;
+    ServerSettings settings;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    // Only used by the thread that runs the server
+    std::unordered_map<uint64_t, std::shared_ptr<Session>> sessions;
+    uint64_t nextId = WAKE_ID + 1;
+    size_t nextWorker = 0;
+
+    vector<Worker> workers;
+    // Amount of queued sessions in all queues, workers sleep while it is 0
+    std::atomic<size_t> queued = 0;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    std::mutex timerMutex;
+    std::priority_queue<Timer, vector<Timer>, std::greater<Timer>> timers;
+    // Sessions that ended on a worker, to be removed by the server thread
+    std::mutex finishedMutex;
+    vector<uint64_t> finished;
+
+    std::mutex statsMutex;
+    unsigned long sessionCount = 0;
+    unsigned long rejectedCount = 0;
+    size_t peakSessions = 0;
+    unsigned long bytesSent = 0;
+    GameLoop loopTotals = GameLoop(settings.loop);
+    LatencyStats latencyTotals;
+
+    static void requestStop(int) {
+        stopRequested = true;
+        uint64_t one = 1;
+        (void)!write(signalWakeFd, &one, sizeof(one));
+    }
+
+    /**
+     * Thousands of sessions need as many file descriptors, more than the usual soft limit allows.
+     */
+    static void raiseFileLimit() {
+        rlimit limit = {};
+        if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    void watch(int fd, uint64_t id, uint32_t events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        (void)!write(wakeFd, &one, sizeof(one));
+    }
+
+    void acceptSessions() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return; // EAGAIN, or out of file descriptors until sessions end
+            }
+            std::lock_guard lock(statsMutex);
+            if (sessions.size() >= settings.maxSessions) {
+                close(fd);
+                rejectedCount++;
+                continue;
+            }
+            uint64_t id = nextId++;
+            auto session = std::make_shared<Session>(id, fd, levels, settings);
+            sessions.emplace(id, session);
+            sessionCount++;
+            peakSessions = std::max(peakSessions, sessions.size());
+            // Edge triggered: the session reads and writes until the socket would block, and is only woken again after that
+            watch(fd, id, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            schedule(session, nextWorker++ % workers.size());
+        }
+    }
+
+    /**
+     * Queue the session on the given worker, unless it is queued already.
+     * If it is running right now, it runs again right after instead, so that it does not run on two workers at once.
+     */
+    void schedule(const std::shared_ptr<Session>& session, size_t worker) {
+        Session::Scheduling state = session->scheduling.load();
+        while (true) {
+            if (state == Session::Scheduling::IDLE) {
+                if (session->scheduling.compare_exchange_weak(state, Session::Scheduling::QUEUED)) break;
+            }
+            else if (state == Session::Scheduling::RUNNING) {
+                if (session->scheduling.compare_exchange_weak(state, Session::Scheduling::RUNNING_AGAIN)) return;
+            }
+            else return;
+        }
+        push(session, worker);
+    }
+
+    void push(const std::shared_ptr<Session>& session, size_t worker) {
+        {
+            std::lock_guard lock(workers[worker].mutex);
+            workers[worker].queue.push_back(session);
+        }
+        queued++;
+        // Taking the lock makes sure a worker that is about to sleep sees the new session
+        { std::lock_guard lock(sleepMutex); }
+        wakeUp.notify_one();
+    }
+
+    /**
+     * Take the next session from the worker's own queue, or steal one from another worker.
+     *
+     * @return The session, or nullptr once the server stops.
+     */
+    std::shared_ptr<Session> take(size_t worker) {
+        while (true) {
+            for (size_t i = 0; i < workers.size(); i++) {
+                Worker& victim = workers[(worker + i) % workers.size()];
+                std::lock_guard lock(victim.mutex);
+                if (victim.queue.empty()) continue;
+                std::shared_ptr<Session> session;
+                if (i == 0) {
+                    session = std::move(victim.queue.back());
+                    victim.queue.pop_back();
+                }
+                else {
+                    session = std::move(victim.queue.front());
+                    victim.queue.pop_front();
+                }
+                queued--;
+                return session;
+            }
+            std::unique_lock lock(sleepMutex);
+            wakeUp.wait(lock, [this]() { return queued > 0 || stopping; });
+            if (stopping) return nullptr;
+        }
+    }
+
+    void work(size_t worker) {
+        while (std::shared_ptr<Session> session = take(worker)) {
+            session->scheduling = Session::Scheduling::RUNNING;
+            if (!session->update()) {
+                session->scheduling = Session::Scheduling::FINISHED;
+                finish(*session);
+                {
+                    std::lock_guard lock(finishedMutex);
+                    finished.push_back(session->getId());
+                }
+                wake();
+                continue;
+            }
+            Clock::time_point next = session->getNextUpdate();
+            if (next != Clock::time_point::max()) addTimer(*session, next);
+
+            Session::Scheduling state = Session::Scheduling::RUNNING;
+            if (!session->scheduling.compare_exchange_strong(state, Session::Scheduling::IDLE)) {
+                session->scheduling = Session::Scheduling::QUEUED;
+                push(session, worker);
+            }
+        }
+    }
+
+    void addTimer(Session& session, Clock::time_point time) {
+        unsigned long generation = ++session.timerGeneration;
+        bool earliest;
+        {
+            std::lock_guard lock(timerMutex);
+            earliest = timers.empty() || time < timers.top().time;
+            timers.push({time, session.getId(), generation});
+        }
+        // The server thread might be waiting for a later timer
+        if (earliest) wake();
+    }
+
+    /**
+     * @return How many milliseconds the server thread can wait until the next timer is due, -1 if there is none.
+     */
+    int getTimeout() {
+        std::lock_guard lock(timerMutex);
+        if (timers.empty()) return -1;
+        auto wait = timers.top().time - Clock::now();
+        if (wait <= Clock::duration::zero()) return 0;
+        return std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+    }
+
+    void scheduleDueTimers() {
+        Clock::time_point now = Clock::now();
+        vector<Timer> due;
+        {
+            std::lock_guard lock(timerMutex);
+            while (!timers.empty() && timers.top().time <= now) {
+                due.push_back(timers.top());
+                timers.pop();
+            }
+        }
+        for (const Timer& timer : due) {
+            auto session = sessions.find(timer.id);
+            if (session == sessions.end() || session->second->timerGeneration != timer.generation) continue;
+            schedule(session->second, nextWorker++ % workers.size());
+        }
+    }
+
+    void removeFinishedSessions() {
+        vector<uint64_t> ids;
+        {
+            std::lock_guard lock(finishedMutex);
+            ids.swap(finished);
+        }
+        std::lock_guard lock(statsMutex);
+        for (uint64_t id : ids) sessions.erase(id);
+    }
+
+    /**
+     * Stop watching the session's connection and add its statistics to the totals.
+     * The connection is closed once the last reference to the session is gone.
+     */
+    void finish(Session& session) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, session.getFd(), nullptr);
+        std::lock_guard lock(statsMutex);
+        bytesSent += session.getBytesSent();
+        loopTotals.merge(session.getLoop());
+        latencyTotals.merge(session.getLatency());
+    }
+};
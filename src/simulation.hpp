@@ -0,0 +1,146 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "movementHandler.hpp"
+#include "stateHash.hpp"
+
+using std::string;
+using std::vector;
+
+/**
+ * How a replayed sequence of inputs ended.
+ */
+enum class ReplayOutcome {
+    GOAL,
+    DEATH,
+    INPUT_EXHAUSTED
+};
+
+/**
+ * Get the name of the given outcome, as used in reports.
+ */
+string toString(ReplayOutcome outcome) {
+    switch (outcome) {
+        case ReplayOutcome::GOAL: return "goal";
+        case ReplayOutcome::DEATH: return "death";
+        default: return "input_exhausted";
+    }
+}
+
+/**
+ * Which state hashes (see Player::getStateHash) a replay computes.
+ */
+enum class ReplayHashes {
+    NONE,
+    FINAL,
+    EVERY_STEP
+};
+
+/**
+ * A line of TEST.txt: the keys to press, optionally followed by '|' and the expected state hashes, separated by spaces.
+ * A single hash is compared to the state at the end of the replay, multiple hashes to the state after each step.
+ * Example: "ddwa|3f2a... 91c0..."
+ */
+struct Replay {
+    string inputs;
+    vector<uint64_t> expectedHashes;
+};
+
+/**
+ * Split a line of TEST.txt into its inputs and expected hashes.
+ * Anything that is not a hexadecimal number after the '|' is ignored.
+ */
+Replay parseReplay(const string& line) {
+    size_t separator = line.find('|');
+    Replay replay = {line.substr(0, separator), {}};
+    if (separator == string::npos) return replay;
+    const char* next = line.c_str() + separator + 1;
+    while (*next != '\0') {
+        char* end;
+        uint64_t hash = std::strtoull(next, &end, 16);
+        if (end == next) next++; // Not a number
+        else {
+            replay.expectedHashes.push_back(hash);
+            next = end;
+        }
+    }
+    return replay;
+}
+
+/**
+ * Write a line in the format of TEST.txt.
+ *
+ * @param inputs The keys to press.
+ * @param hashes The state hashes to expect.
+ */
+string formatReplay(const string& inputs, const vector<uint64_t>& hashes) {
+    string line = inputs;
+    for (size_t i = 0; i < hashes.size(); i++) line += (i == 0 ? "|" : " ") + formatHash(hashes[i]);
+    return line;
+}
+
+struct ReplayResult {
+    ReplayOutcome outcome;
+    BlockPos finalPos;
+    // Amount of input characters that were processed before the replay ended
+    unsigned int inputsUsed;
+    // The state hashes that were computed: none, the final one, or one after every step
+    vector<uint64_t> hashes = {};
+    // Whether a state did not have the expected hash, and after which step (counting from 1)
+    bool diverged = false;
+    unsigned int divergedStep = 0;
+    uint64_t expectedHash = 0;
+    uint64_t actualHash = 0;
+};
+
+/**
+ * Plays the given inputs in the given world as fast as possible.
+ * Nothing is rendered and no time is spent waiting, only the game logic is executed.
+ * The replay stops as soon as the player dies or reaches the goal.
+ *
+ * If the line carries expected hashes, the state is hashed after every step (or at the end, for a single hash)
+ * and the first step whose hash differs is reported. Hashing is incremental, so this hardly slows the replay down.
+ *
+ * @param world Reference to the World object to play in. It is modified by the replay.
+ * @param line The characters to feed into onInput, in the same format as the lines in TEST.txt.
+ * @param hashes Which hashes to compute, at least those needed to check the expected hashes.
+ * @return How the replay ended and where the player was at that point.
+ */
+ReplayResult simulateReplay(World& world, const string& line, ReplayHashes hashes = ReplayHashes::NONE) {
+    Replay replay = parseReplay(line);
+    if (replay.expectedHashes.size() > 1) hashes = ReplayHashes::EVERY_STEP;
+    else if (replay.expectedHashes.size() == 1 && hashes == ReplayHashes::NONE) hashes = ReplayHashes::FINAL;
+
+    Player player = Player(world.getStartPos(), world);
+    ReplayResult result = {ReplayOutcome::INPUT_EXHAUSTED, player.getPos(), 0};
+    for (char input : replay.inputs) {
+        if (!player.isAlive() || player.hasReachedGoal()) break;
+        onInput(input, world, player);
+        world.clearDirtyCells(); // Nothing is drawn, so changed cells do not need to be remembered
+        result.inputsUsed++;
+        if (hashes == ReplayHashes::EVERY_STEP) result.hashes.push_back(player.getStateHash());
+    }
+    if (hashes == ReplayHashes::FINAL) result.hashes.push_back(player.getStateHash());
+
+    bool finalOnly = replay.expectedHashes.size() == 1;
+    for (size_t step = 0; step < replay.expectedHashes.size(); step++) {
+        uint64_t actual = 0; // If the replay ended before this step, no hash matches
+        if (finalOnly) actual = player.getStateHash();
+        else if (step < result.hashes.size()) actual = result.hashes[step];
+        if (actual == replay.expectedHashes[step]) continue;
+        result.diverged = true;
+        result.divergedStep = finalOnly ? result.inputsUsed : step + 1;
+        result.expectedHash = replay.expectedHashes[step];
+        result.actualHash = actual;
+        break;
+    }
+    if (!player.isAlive()) result.outcome = ReplayOutcome::DEATH;
+    else if (player.hasReachedGoal()) result.outcome = ReplayOutcome::GOAL;
+    result.finalPos = player.getPos();
+    return result;
+}
@@ -0,0 +1,82 @@
+#include <string>
+#include <iostream>
+#include <chrono>
+
+#include "world.hpp"
+#include "blockRegistry.hpp"
+#include "simulation.hpp"
+#include "solver.hpp"
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+/**
+ * Stream buffer that throws away everything written to it.
+ * The movement code logs some edge cases to cout, which would otherwise end up between the solutions.
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+/**
+ * Finds the shortest solution for each of the given worlds and prints it to stdout, one line per world.
+ * The lines use the same format as TEST.txt, so the output can be pasted there directly.
+ * Statistics and errors are printed to stderr. Worlds without a solution get an empty line.
+ *
+ * Usage: solver [--threads <n>] [--max-depth <n>] [--table-size <n>] <world files...>
+ * --threads 0 searches with all cores.
+ */
+int main(int argc, char *argv[]) {
+    SolverOptions options;
+    vector<string> worldFiles;
+    for (int i = 1; i < argc; i++) {
+        string arg = string(argv[i]);
+        if (arg == "--threads" && argc > i + 1) options.threads = std::stoul(argv[++i]);
+        else if (arg == "--max-depth" && argc > i + 1) options.maxDepth = std::stoul(argv[++i]);
+        else if (arg == "--table-size" && argc > i + 1) options.tableSize = std::stoul(argv[++i]);
+        else worldFiles.push_back(arg);
+    }
+    if (worldFiles.empty()) {
+        cerr << "Usage: solver [--threads <n>] [--max-depth <n>] [--table-size <n>] <world files...>" << endl;
+        return 1;
+    }
+
+    int exitCode = 0;
+    NullBuffer nullBuffer;
+    for (const string& worldFile : worldFiles) {
+        World world = World(BlockRegistry());
+        world.loadFromFile(worldFile);
+
+        auto start = std::chrono::steady_clock::now();
+        std::streambuf* output = cout.rdbuf(&nullBuffer);
+        SolverResult result = Solver(world, options).solve();
+        cout.rdbuf(output);
+        auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+        cout << result.inputs << endl;
+        cerr << worldFile << ": " << (result.solved ? "solved with " + std::to_string(result.inputs.size()) + " inputs" : "no solution found")
+             << ", " << result.statesExplored << " states explored in " << duration.count() << "ms";
+        if (result.tableOverflows > 0) cerr << ", transposition table overflowed " << result.tableOverflows << " times";
+        cerr << endl;
+
+        // Double check the solution with a regular replay
+        if (result.solved) {
+            World replayWorld = World(BlockRegistry());
+            replayWorld.loadFromFile(worldFile);
+            output = cout.rdbuf(&nullBuffer);
+            ReplayResult replay = simulateReplay(replayWorld, result.inputs);
+            cout.rdbuf(output);
+            if (replay.outcome != ReplayOutcome::GOAL) {
+                cerr << worldFile << ": solution does not reach the goal when replayed (" << toString(replay.outcome) << ")" << endl;
+                exitCode = 1;
+            }
+        }
+        else exitCode = 1;
+    }
+    return exitCode;
+}
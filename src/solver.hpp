@@ -0,0 +1,315 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "movementHandler.hpp"
+
+using std::vector;
+using std::string;
+
+/**
+ * Set of state hashes with a fixed capacity that can be shared between threads.
+ *
+ * If all slots a hash could be stored in are taken, the hash is not stored and the state counts as new.
+ * This means a state can be explored more than once when the table is full, but memory never grows.
+ */
+class TranspositionTable {
+public:
+    TranspositionTable(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots = vector<std::atomic<uint64_t>>(size);
+        mask = size - 1;
+    }
+
+    /**
+     * Adds the hash to the table.
+     *
+     * @param hash The hash of the state.
+     * @return True if the hash was not seen before, false otherwise.
+     */
+    bool insert(uint64_t hash) {
+        if (hash == EMPTY) hash = 1;
+        for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+            std::atomic<uint64_t>& slot = slots[(hash + probe) & mask];
+            uint64_t current = slot.load(std::memory_order_relaxed);
+            if (current == EMPTY && slot.compare_exchange_strong(current, hash, std::memory_order_relaxed)) return true;
+            if (current == hash) return false;
+        }
+        overflows++;
+        return true;
+    }
+
+    /**
+     * @param hash The hash of the state.
+     * @return True if the hash was added before. Hashes that could not be stored because the table was too full are never contained.
+     */
+    bool contains(uint64_t hash) {
+        if (hash == EMPTY) hash = 1;
+        for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+            uint64_t current = slots[(hash + probe) & mask].load(std::memory_order_relaxed);
+            if (current == hash) return true;
+            if (current == EMPTY) return false;
+        }
+        return false;
+    }
+
+    /**
+     * @return How often a hash could not be stored, because the table was too full.
+     */
+    unsigned long getOverflows() {
+        return overflows;
+    }
+
+private:
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr size_t MAX_PROBES = 16;
+    vector<std::atomic<uint64_t>> slots;
+    size_t mask;
+    std::atomic<unsigned long> overflows = 0;
+};
+
+struct SolverOptions {
+    // Amount of threads to search with, 0 uses all cores
+    unsigned int threads = 1;
+    // Maximum length of a solution
+    unsigned int maxDepth = 10000;
+    // Amount of states the transposition table can hold
+    size_t tableSize = 1 << 22;
+};
+
+struct SolverResult {
+    bool solved;
+    // The shortest sequence of inputs that reaches the goal, in the same format as the lines in TEST.txt
+    string inputs;
+    unsigned long statesExplored;
+    unsigned long tableOverflows;
+};
+
+/**
+ * Finds the shortest sequence of inputs that leads the player to the goal of a world without dying.
+ *
+ * Performs a breadth-first search over all reachable game states, using the actual movement code to make moves.
+ * A state consists of the player's position, the positions of all blocks that can move (pushable blocks and blocks with gravity)
+ * and the size of the world, which grows when a block falls out of it. Every other block stays in place for the whole game.
+ * States are identified by a Zobrist-style hash that is updated from the cells a move changed,
+ * and already visited states are skipped using a bounded transposition table.
+ *
+ * The result does not depend on the amount of threads or their timing: of all shortest solutions,
+ * the one that comes first when comparing inputs in the order w, a, s, d is found.
+ */
+class Solver {
+public:
+    /**
+     * @param world The world to solve, freshly loaded. It is not modified.
+     * @param options Settings for the search.
+     */
+    Solver(World& world, SolverOptions options) : world(world), options(options), table(options.tableSize) {
+        if (this->options.threads == 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    SolverResult solve() {
+        // The initial state contains all movable blocks as they are placed in the world file
+        Frontier frontier;
+        for (unsigned int y = 0; y <= world.getMaxY(); y++) {
+            for (unsigned int x = 0; x <= world.getMaxX(); x++) {
+                const Block& block = world.getBlockAt(BlockPos(x, y));
+                if (isMovable(block)) frontier.blocks.push_back(packBlock(BlockPos(x, y), block.getRawId()));
+            }
+        }
+        uint64_t hash = playerKey(world.getStartPos()) ^ sizeKey(world.getWidth(), world.getHeight());
+        for (uint64_t block : frontier.blocks) hash ^= blockKey(block);
+        frontier.states.push_back({0, world.getStartPos(), hash, 0, static_cast<uint32_t>(frontier.blocks.size()), world.getWidth(), world.getHeight()});
+        history = {{-1, ' '}};
+        table.insert(hash);
+
+        vector<Worker> workers;
+        for (unsigned int i = 0; i < options.threads; i++) workers.emplace_back(world);
+
+        unsigned long statesExplored = 1;
+        for (unsigned int depth = 0; depth < options.maxDepth && !frontier.states.empty(); depth++) {
+            size_t chunk = (frontier.states.size() + workers.size() - 1) / workers.size();
+            vector<std::thread> threads;
+            for (unsigned int i = 0; i < workers.size(); i++) {
+                size_t from = std::min(frontier.states.size(), i * chunk);
+                size_t to = std::min(frontier.states.size(), from + chunk);
+                if (workers.size() == 1) expandAll(workers[i], frontier, from, to);
+                else threads.emplace_back([&, i, from, to]() { expandAll(workers[i], frontier, from, to); });
+            }
+            for (std::thread& thread : threads) thread.join();
+
+            // Merge the results of all workers in the order of the frontier, so that the result does not depend on timing.
+            // The states of this depth are only added to the table here: if workers reached the same state, the first one in this order is kept.
+            Frontier next;
+            for (Worker& worker : workers) {
+                int64_t offset = history.size();
+                history.insert(history.end(), worker.steps.begin(), worker.steps.end());
+                uint32_t blocksOffset = next.blocks.size();
+                next.blocks.insert(next.blocks.end(), worker.children.blocks.begin(), worker.children.blocks.end());
+                for (State state : worker.children.states) {
+                    if (!table.insert(state.hash)) continue;
+                    state.history += offset;
+                    state.blocksOffset += blocksOffset;
+                    next.states.push_back(state);
+                    statesExplored++;
+                }
+                // The workers before this one found no goal, so no earlier sequence of inputs reaches it
+                if (worker.goalStep >= 0) return {true, buildInputs(offset + worker.goalStep), statesExplored + 1, table.getOverflows()};
+            }
+            frontier = std::move(next);
+        }
+        return {false, "", statesExplored, table.getOverflows()};
+    }
+
+private:
+    static constexpr char INPUTS[] = {'w', 'a', 's', 'd'};
+
+    struct Step {
+        int64_t parent;
+        char input;
+    };
+    struct State {
+        // Index of the step that led to this state
+        int64_t history;
+        BlockPos player;
+        uint64_t hash;
+        uint32_t blocksOffset;
+        uint32_t blocksCount;
+        unsigned int width;
+        unsigned int height;
+    };
+    // States of one search depth. The movable blocks of all states are stored one after another in blocks.
+    struct Frontier {
+        vector<State> states;
+        vector<uint64_t> blocks;
+    };
+    // Everything a single thread needs to expand states, so that threads share nothing except the transposition table
+    struct Worker {
+        World world;
+        // The movable blocks that are currently placed in this worker's world
+        vector<uint64_t> placed;
+        // The world and its movable blocks before any move, to go back to when a state has a smaller world than the current one
+        World::Snapshot start;
+        vector<uint64_t> startPlaced;
+        Frontier children;
+        // Steps taken to reach the children, with parents pointing into the shared history
+        vector<Step> steps;
+        int64_t goalStep = -1;
+
+        Worker(World& world) : world(world), placed() {
+            for (unsigned int y = 0; y <= world.getMaxY(); y++)
+                for (unsigned int x = 0; x <= world.getMaxX(); x++)
+                    if (isMovable(world.getBlockAt(BlockPos(x, y)))) placed.push_back(packBlock(BlockPos(x, y), world.getBlockAt(BlockPos(x, y)).getRawId()));
+            start = this->world.snapshot();
+            startPlaced = placed;
+        }
+    };
+
+    World& world;
+    SolverOptions options;
+    TranspositionTable table;
+    vector<Step> history;
+
+    static bool isMovable(const Block& block) {
+        return block.getSettings().has(BlockSettings::PUSHABLE | BlockSettings::GRAVITY);
+    }
+    // Blocks are packed into 64 bits: 24 bits for the block id, 20 bits for each coordinate
+    static uint64_t packBlock(BlockPos pos, BlockId id) {
+        return (static_cast<uint64_t>(id) << 40) | (static_cast<uint64_t>(pos.getUnsignedY()) << 20) | pos.getUnsignedX();
+    }
+    static BlockPos unpackPos(uint64_t block) {
+        return BlockPos(block & 0xFFFFF, (block >> 20) & 0xFFFFF);
+    }
+    static BlockId unpackId(uint64_t block) {
+        return block >> 40;
+    }
+    static uint64_t blockKey(uint64_t block) {
+        return mixHash(block);
+    }
+    static uint64_t playerKey(BlockPos pos) {
+        return mixHash(packBlock(pos, 0) | (1ULL << 63));
+    }
+    static uint64_t sizeKey(unsigned int width, unsigned int height) {
+        return mixHash(packBlock(BlockPos(width, height), 0) | (1ULL << 62));
+    }
+
+    void expandAll(Worker& worker, Frontier& frontier, size_t from, size_t to) {
+        worker.children = {};
+        worker.steps.clear();
+        worker.goalStep = -1;
+        for (size_t i = from; i < to && worker.goalStep < 0; i++) expand(worker, frontier, frontier.states[i]);
+    }
+
+    /**
+     * Tries every input in the given state and collects all resulting states that were not visited in an earlier depth.
+     * The table is only read here, states of the current depth are added to it when the results of all workers are merged.
+     */
+    void expand(Worker& worker, Frontier& frontier, State& state) {
+        auto first = frontier.blocks.begin() + state.blocksOffset;
+        auto last = first + state.blocksCount;
+        for (char input : INPUTS) {
+            // Bring the worker's world into the state that is being expanded. A world only grows, so a smaller one starts over from the beginning.
+            if (worker.world.getWidth() > state.width || worker.world.getHeight() > state.height) {
+                worker.world.restore(worker.start);
+                worker.placed = worker.startPlaced;
+            }
+            if (!std::equal(worker.placed.begin(), worker.placed.end(), first, last)) {
+                for (uint64_t block : worker.placed) worker.world.placeBlockAt(unpackPos(block), worker.world.getBlockRegistry().AIR);
+                for (auto block = first; block != last; block++) worker.world.placeBlockAt(unpackPos(*block), worker.world.getBlockRegistry().getById(unpackId(*block)));
+                worker.placed.assign(first, last);
+            }
+            // Rows or columns the state gained without a movable block in them
+            if (worker.world.getWidth() < state.width || worker.world.getHeight() < state.height)
+                worker.world.placeBlockAt(BlockPos(state.width - 1, state.height - 1), worker.world.getBlockRegistry().AIR);
+            worker.world.clearDirtyCells();
+
+            Player player = Player(state.player, worker.world);
+            onInput(input, worker.world, player);
+
+            // Update the movable blocks and the hash using only the cells that changed
+            uint64_t hash = state.hash ^ playerKey(state.player) ^ playerKey(player.getPos())
+                          ^ sizeKey(state.width, state.height) ^ sizeKey(worker.world.getWidth(), worker.world.getHeight());
+            for (BlockPos pos : worker.world.getDirtyCells()) {
+                auto previous = std::find_if(worker.placed.begin(), worker.placed.end(), [&](uint64_t block) {
+                    return unpackPos(block).getX() == pos.getX() && unpackPos(block).getY() == pos.getY();
+                });
+                if (previous != worker.placed.end()) {
+                    hash ^= blockKey(*previous);
+                    worker.placed.erase(previous);
+                }
+                const Block& block = worker.world.getBlockAt(pos);
+                if (isMovable(block)) {
+                    worker.placed.push_back(packBlock(pos, block.getRawId()));
+                    hash ^= blockKey(worker.placed.back());
+                }
+            }
+
+            if (!player.isAlive() || hash == state.hash || table.contains(hash)) continue;
+            worker.steps.push_back({state.history, input});
+            int64_t step = worker.steps.size() - 1;
+            if (player.hasReachedGoal()) {
+                worker.goalStep = step;
+                return;
+            }
+            worker.children.states.push_back({step, player.getPos(), hash, static_cast<uint32_t>(worker.children.blocks.size()), static_cast<uint32_t>(worker.placed.size()),
+                                              worker.world.getWidth(), worker.world.getHeight()});
+            worker.children.blocks.insert(worker.children.blocks.end(), worker.placed.begin(), worker.placed.end());
+        }
+    }
+
+    /**
+     * Follows the steps from the given one back to the initial state and returns the inputs taken on the way.
+     */
+    string buildInputs(int64_t step) {
+        string inputs;
+        for (; history[step].parent >= 0; step = history[step].parent) inputs += history[step].input;
+        std::reverse(inputs.begin(), inputs.end());
+        return inputs;
+    }
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+#include "blockPos.hpp"
+
+using std::string;
+
+/**
+ * Hashes of the game state are built from one hash per non-empty cell, combined with XOR (Zobrist hashing).
+ * This way, changing a single cell only needs the hashes of its old and new block, instead of a scan of the whole world.
+ * Cells are hashed by the encoding of their block, not by its id, so the hash does not depend on the order
+ * in which decoration blocks were registered or on the format the world was loaded from.
+ */
+
+/**
+ * Mixes the bits of the given value, so that similar values produce completely different hashes.
+ * Source: https://prng.di.unimi.it/splitmix64.c
+ */
+inline uint64_t mixHash(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+/**
+ * @return The hash of a cell at the given position that contains the block with the given encoding.
+ */
+inline uint64_t hashCell(BlockPos pos, char encoding) {
+    uint64_t position = (static_cast<uint64_t>(pos.getUnsignedY()) << 32) | pos.getUnsignedX();
+    return mixHash(mixHash(position) + static_cast<unsigned char>(encoding));
+}
+
+/**
+ * @return The hash of the player's state.
+ * It is based on a position no cell can have, so that it does not cancel out the hash of the cell the player is in.
+ */
+inline uint64_t hashPlayer(BlockPos pos, int fallLength, bool alive, bool reachedGoal) {
+    // Flips the sign bits of both coordinates, which are never set for a position inside of the world
+    constexpr uint64_t PLAYER_SEED = 0x8000000080000000ULL;
+    uint64_t position = ((static_cast<uint64_t>(pos.getUnsignedY()) << 32) | pos.getUnsignedX()) ^ PLAYER_SEED;
+    uint64_t flags = (static_cast<uint64_t>(static_cast<unsigned int>(fallLength)) << 2) | (alive << 1) | reachedGoal;
+    return mixHash(mixHash(position) + flags);
+}
+
+/**
+ * @return The hash as 16 hexadecimal digits, as used in TEST.txt.
+ */
+inline string formatHash(uint64_t hash) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
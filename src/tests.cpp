@@ -0,0 +1,122 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "world.hpp"
+#include "player.hpp"
+#include "blockRegistry.hpp"
+#include "movementHandler.hpp"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+unsigned int checks = 0;
+unsigned int failures = 0;
+
+/**
+ * Counts a check and prints its name in case it failed.
+ *
+ * @param name What was checked.
+ * @param passed Whether the check passed.
+ */
+void check(const string& name, bool passed) {
+    checks++;
+    if (passed) return;
+    cout << "Failed: " << name << endl;
+    failures++;
+}
+
+/**
+ * Loads a world from the given text, which has the same format as the files in the worlds directory.
+ *
+ * @param text The lines of the world, starting with its title.
+ * @return The loaded world.
+ */
+World worldFromText(const string& text) {
+    string file = (std::filesystem::temp_directory_path() / "adventuraTests.txt").string();
+    std::ofstream(file) << text;
+    World world = World(BlockRegistry());
+    world.loadFromFile(file);
+    world.decodeAllChunks(); // The file is removed right away
+    std::filesystem::remove(file);
+    return world;
+}
+
+/**
+ * Plays the given keys, starting at the start position of the world.
+ *
+ * @return The player after the last key.
+ */
+Player play(World& world, const string& keys) {
+    Player player = Player(world.getStartPos(), world);
+    for (char key : keys) onInput(key, world, player);
+    return player;
+}
+
+void testAnyInRow() {
+    World world = worldFromText("Row\n0 0\n");
+    const uint16_t COLLISION = BlockSettings::COLLISION;
+    check("anyInRow finds a wall in the span", world.anyInRow(1, 0, 2, COLLISION));
+    check("anyInRow finds nothing between the walls", !world.anyInRow(1, 1, 1, COLLISION));
+    check("anyInRow finds a wall in a span that starts left of the world", world.anyInRow(1, -5, 0, COLLISION));
+    check("anyInRow finds nothing in a reversed span", !world.anyInRow(1, 2, 0, COLLISION));
+    check("anyInRow finds nothing in a reversed span that starts right of the world", !world.anyInRow(1, 5, -3, COLLISION));
+    check("anyInRow finds nothing in a reversed span above the world", !world.anyInRow(-1, 3, 1, COLLISION));
+}
+
+void testSandCollapse() {
+    // The player starts on the sand, with a hole of two cells below it
+    World world = worldFromText("Sand\n\nS\n\n---*---\n--- ---\n--- ---\n-------\n");
+    const Block& SAND = world.getBlockRegistry().SAND;
+    play(world, "d");
+    check("sand falls to the bottom of the hole", world.getBlockAt(BlockPos(3, 6)) == SAND);
+    check("sand leaves its cell when it falls", world.getBlockAt(BlockPos(3, 4)) == world.getBlockRegistry().AIR);
+    check("sand is moved, not copied, when it falls", world.getBlockAmount(SAND) == 1);
+}
+
+void testSandFallsOutOfTheWorld() {
+    // The player starts on sand in the bottom row
+    World world = worldFromText("Edge\n\nS\n\n---*---\n");
+    const Block& SAND = world.getBlockRegistry().SAND;
+    play(world, "d");
+    check("sand from the bottom row adds a row to the world", world.getHeight() == 6);
+    check("sand from the bottom row moves into the added row", world.getBlockAt(BlockPos(3, 5)) == SAND);
+    check("sand from the bottom row leaves a hole", world.getBlockAt(BlockPos(3, 4)) == world.getBlockRegistry().AIR);
+    check("sand from the bottom row is moved, not copied", world.getBlockAmount(SAND) == 1);
+}
+
+void testRestoreKeepsBlockAmounts() {
+    // The player starts on the sand, with a hole of two cells below it
+    World world = worldFromText("Sand\n\nS\n\n---*---\n--- ---\n--- ---\n-------\n");
+    const Block& SAND = world.getBlockRegistry().SAND;
+    const Block& WALL = world.getBlockRegistry().WALL;
+    world.getBlockAmount(SAND);
+    World::Snapshot start = world.snapshot();
+    world.placeBlockAt(BlockPos(0, 1), WALL);
+    play(world, "d");
+    world.restore(start);
+    check("restoring a snapshot brings back the amount of walls", world.getBlockAmount(WALL) == 0);
+    check("restoring a snapshot brings back the amount of sand", world.getBlockAmount(SAND) == 1);
+    check("restoring a snapshot brings back the sand", world.getBlockAt(BlockPos(3, 4)) == SAND);
+}
+
+/**
+ * Checks for behaviour that the replays in TEST.txt do not reach, like edge cases of the world queries.
+ * Prints every check that failed and returns 1 if there was any.
+ *
+ * Usage: tests
+ */
+int main() {
+    testAnyInRow();
+    testSandCollapse();
+    testSandFallsOutOfTheWorld();
+    testRestoreKeepsBlockAmounts();
+    if (failures > 0) {
+        cout << failures << " of " << checks << " checks failed" << endl;
+        return 1;
+    }
+    cout << "All " << checks << " checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+using std::string;
+using std::vector;
+
+/**
+ * Instrumentation of the game's hot paths, to see where the time of a session goes.
+ *
+ * Tracing is only compiled in if ADVENTURA_TRACING is defined (g++ -DADVENTURA_TRACING ...).
+ * Otherwise every function below is empty and optimized away, so the instrumented code costs nothing.
+ * When compiled in, nothing is recorded until Tracer::start is called (see the --trace flag).
+ *
+ * Two kinds of data are recorded:
+ * - counters, which count calls or bytes (see TraceCounter) and are sampled after every frame
+ * - spans, which measure how long a named section took
+ * Both can be written as Chrome trace_event JSON (viewable in chrome://tracing or Perfetto) and summarized as a table.
+ */
+#ifdef ADVENTURA_TRACING
+constexpr bool TRACING_COMPILED = true;
+#else
+constexpr bool TRACING_COMPILED = false;
+#endif
+
+enum class TraceCounter {
+    GET_BLOCK,
+    SET_BLOCK,
+    ENCODING_LOOKUP,
+    BYTES_RENDERED,
+    FALL_STEPS,
+    COUNT
+};
+constexpr std::array<const char*, static_cast<size_t>(TraceCounter::COUNT)> TRACE_COUNTER_NAMES {
+    "World::getBlockAt", "World::setBlockAt", "BlockRegistry::getByEncoding", "Bytes rendered", "Fall steps"
+};
+
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Start recording. Does nothing if tracing is not compiled in.
+     */
+    static void start() {
+        if constexpr (TRACING_COMPILED) {
+            startTime = Clock::now();
+            enabled = true;
+        }
+    }
+
+    /**
+     * @return Whether tracing is compiled in and was started.
+     */
+    static bool isEnabled() {
+        if constexpr (TRACING_COMPILED) return enabled.load(std::memory_order_relaxed);
+        else return false;
+    }
+
+    /**
+     * Add the given amount to a counter.
+     */
+    static void count(TraceCounter counter, unsigned long amount = 1) {
+        if constexpr (TRACING_COMPILED) {
+            if (enabled.load(std::memory_order_relaxed)) counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Remember the current value of every counter, so that the trace shows how they grow over time.
+     */
+    static void sampleCounters() {
+        if constexpr (TRACING_COMPILED) {
+            if (!isEnabled()) return;
+            Sample sample = {Clock::now(), {}};
+            for (size_t i = 0; i < counters.size(); i++) sample.values[i] = counters[i].load(std::memory_order_relaxed);
+            std::lock_guard lock(mutex);
+            samples.push_back(sample);
+        }
+    }
+
+    /**
+     * Record a finished span.
+     *
+     * @param name What was measured.
+     * @param detail Distinguishes spans of the same name, e.g. the level that was loaded. May be empty.
+     */
+    static void recordSpan(const char* name, std::string_view detail, Clock::time_point start, Clock::time_point end) {
+        if constexpr (TRACING_COMPILED) {
+            unsigned int thread = getThreadId();
+            std::lock_guard lock(mutex);
+            spans.push_back({name, string(detail), start, end, thread});
+        }
+    }
+
+    /**
+     * Write everything recorded so far to the given file as Chrome trace_event JSON.
+     *
+     * @return False if the file could not be written.
+     */
+    static bool writeChromeTrace(const string& fileLocation) {
+        std::lock_guard lock(mutex);
+        std::ofstream file(fileLocation);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const Span& span : spans) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"" << span.name << "\",\"cat\":\"adventura\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+                 << ",\"ts\":" << microseconds(span.start) << ",\"dur\":" << microseconds(span.end) - microseconds(span.start);
+            if (!span.detail.empty()) file << ",\"args\":{\"detail\":\"" << escape(span.detail) << "\"}";
+            file << "}";
+            first = false;
+        }
+        for (const Sample& sample : samples) {
+            for (size_t i = 0; i < counters.size(); i++) {
+                file << (first ? "\n" : ",\n") << "{\"name\":\"" << TRACE_COUNTER_NAMES[i] << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << microseconds(sample.time)
+                     << ",\"args\":{\"value\":" << sample.values[i] << "}}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        file.close();
+        return file.good();
+    }
+
+    /**
+     * Print the total of every counter, followed by the amount and duration of the spans, grouped by name and detail.
+     */
+    static void printSummary(std::ostream& out) {
+        std::lock_guard lock(mutex);
+        struct Total {
+            unsigned long count = 0;
+            double total = 0;
+            double max = 0;
+        };
+        std::map<string, Total> totals;
+        for (const Span& span : spans) {
+            Total& total = totals[span.detail.empty() ? string(span.name) : string(span.name) + " " + span.detail];
+            double milliseconds = std::chrono::duration<double, std::milli>(span.end - span.start).count();
+            total.count++;
+            total.total += milliseconds;
+            total.max = std::max(total.max, milliseconds);
+        }
+
+        out << "Counter                          Total" << std::endl;
+        for (size_t i = 0; i < counters.size(); i++)
+            out << pad(TRACE_COUNTER_NAMES[i], 32) << " " << counters[i].load(std::memory_order_relaxed) << std::endl;
+        out << "Span                             Count   Total ms     Avg ms     Max ms" << std::endl;
+        for (const auto& [name, total] : totals) {
+            out << pad(name, 32) << " " << pad(std::to_string(total.count), 7) << " " << pad(format(total.total), 10) << " "
+                << pad(format(total.total / total.count), 10) << " " << format(total.max) << std::endl;
+        }
+    }
+
+private:
+    struct Span {
+        const char* name;
+        string detail;
+        Clock::time_point start;
+        Clock::time_point end;
+        unsigned int thread;
+    };
+    struct Sample {
+        Clock::time_point time;
+        std::array<unsigned long, static_cast<size_t>(TraceCounter::COUNT)> values;
+    };
+
+    static inline std::atomic<bool> enabled = false;
+    static inline std::array<std::atomic<unsigned long>, static_cast<size_t>(TraceCounter::COUNT)> counters {};
+    static inline Clock::time_point startTime;
+    static inline std::atomic<unsigned int> threadCount = 0;
+    // Guards spans and samples, which are recorded by the game and the level loading threads
+    static inline std::mutex mutex;
+    static inline vector<Span> spans;
+    static inline vector<Sample> samples;
+
+    /**
+     * @return A small number identifying the calling thread in the trace.
+     */
+    static unsigned int getThreadId() {
+        thread_local unsigned int id = threadCount++;
+        return id;
+    }
+
+    static long long microseconds(Clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - startTime).count();
+    }
+
+    static string escape(const string& text) {
+        string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+        return escaped;
+    }
+
+    static string pad(const string& text, size_t width) {
+        return text.size() >= width ? text : text + string(width - text.size(), ' ');
+    }
+
+    static string format(double milliseconds) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", milliseconds);
+        return buffer;
+    }
+};
+
+/**
+ * Measures the time from its creation until it goes out of scope as a span.
+ * Costs nothing if tracing is not compiled in.
+ */
+class TraceSpan {
+public:
+    /**
+     * @param name What is measured, or nullptr to not record anything.
+     * @param detail Distinguishes spans of the same name. Has to stay valid until the span ends.
+     */
+    TraceSpan(const char* name, std::string_view detail = {}) {
+        if constexpr (TRACING_COMPILED) {
+            if (name == nullptr || !Tracer::isEnabled()) return;
+            this->name = name;
+            this->detail = detail;
+            start = Tracer::Clock::now();
+        }
+    }
+    ~TraceSpan() {
+        if constexpr (TRACING_COMPILED) {
+            if (name != nullptr) Tracer::recordSpan(name, detail, start, Tracer::Clock::now());
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name = nullptr;
+    std::string_view detail;
+    Tracer::Clock::time_point start;
+};
+
+/**
+ * Traces everything while it exists, if a trace file is given.
+ * On destruction, the trace is written to that file and the summary is printed to the given stream.
+ */
+class TraceSession {
+public:
+    /**
+     * @param fileLocation Where to write the trace. If empty, nothing is traced.
+     * @param summary Where to print the summary.
+     */
+    TraceSession(string fileLocation, std::ostream& summary) : fileLocation(fileLocation), summary(summary) {
+        if (fileLocation.empty()) return;
+        if (!TRACING_COMPILED) summary << "Tracing is not compiled in, build with -DADVENTURA_TRACING to use --trace" << std::endl;
+        Tracer::start();
+    }
+    ~TraceSession() {
+        if (!Tracer::isEnabled()) return;
+        Tracer::printSummary(summary);
+        if (!Tracer::writeChromeTrace(fileLocation)) summary << fileLocation << ": could not be written" << std::endl;
+        else summary << "Trace written to " << fileLocation << std::endl;
+    }
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+private:
+    string fileLocation;
+    std::ostream& summary;
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#include "world.hpp"
+#include "blockRegistry.hpp"
+#include "simulation.hpp"
+
+using std::string;
+using std::vector;
+
+struct ValidationResult {
+    string worldFile;
+    ReplayResult replay;
+    double loadMilliseconds;
+    double replayMilliseconds;
+};
+
+/**
+ * Replays the given inputs in each of the given worlds, spread over a pool of threads.
+ *
+ * Every world is loaded with its own BlockRegistry, World and Player, so the threads share nothing
+ * except the index of the next world to check.
+ *
+ * @param worldFiles The worlds to check.
+ * @param replays The inputs for each world, replays[i] belongs to worldFiles[i]. Missing entries count as no input.
+ * @param threads Amount of threads to use, 0 uses all cores.
+ * @return The result for each world, in the same order as worldFiles.
+ */
+vector<ValidationResult> validateWorlds(const vector<string>& worldFiles, const vector<string>& replays, unsigned int threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    vector<ValidationResult> results(worldFiles.size(), {"", {ReplayOutcome::INPUT_EXHAUSTED, BlockPos(0, 0), 0}, 0, 0});
+    std::atomic<size_t> nextWorld = 0;
+
+    auto work = [&]() {
+        for (size_t i = nextWorld++; i < worldFiles.size(); i = nextWorld++) {
+            auto start = std::chrono::steady_clock::now();
+            World world = World(BlockRegistry());
+            world.loadFromFile(worldFiles[i]);
+            auto loaded = std::chrono::steady_clock::now();
+            ReplayResult replay = simulateReplay(world, i < replays.size() ? replays[i] : "", ReplayHashes::FINAL);
+            auto done = std::chrono::steady_clock::now();
+
+            results[i] = {worldFiles[i], replay,
+                std::chrono::duration<double, std::milli>(loaded - start).count(),
+                std::chrono::duration<double, std::milli>(done - loaded).count()};
+        }
+    };
+    vector<std::thread> pool;
+    for (unsigned int i = 1; i < std::min<size_t>(threads, worldFiles.size()); i++) pool.emplace_back(work);
+    work(); // The calling thread helps out as well
+    for (std::thread& thread : pool) thread.join();
+    return results;
+}
+
+/**
+ * Escapes the given text, so that it can be used as a string in JSON.
+ */
+string escapeJson(const string& text) {
+    string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) escaped += ' ';
+        else escaped += c;
+    }
+    return escaped;
+}
+
+/**
+ * Prints the results as JSON lines, one object per world, followed by a summary object.
+ * A world passes if its replay reaches the goal and every expected state hash matched.
+ *
+ * @return True if every world passed.
+ */
+bool printValidationReport(const vector<ValidationResult>& results, double totalMilliseconds, std::ostream& out) {
+    unsigned int passed = 0;
+    for (const ValidationResult& result : results) {
+        bool pass = result.replay.outcome == ReplayOutcome::GOAL && !result.replay.diverged;
+        if (pass) passed++;
+        BlockPos finalPos = result.replay.finalPos;
+        out << "{\"world\":\"" << escapeJson(result.worldFile) << "\""
+            << ",\"pass\":" << (pass ? "true" : "false")
+            << ",\"outcome\":\"" << toString(result.replay.outcome) << "\""
+            << ",\"x\":" << finalPos.getX() << ",\"y\":" << finalPos.getY()
+            << ",\"inputs\":" << result.replay.inputsUsed
+            << ",\"hash\":\"" << (result.replay.hashes.empty() ? "" : formatHash(result.replay.hashes.back())) << "\"";
+        if (result.replay.diverged) {
+            out << ",\"diverged_step\":" << result.replay.divergedStep
+                << ",\"expected_hash\":\"" << formatHash(result.replay.expectedHash) << "\""
+                << ",\"actual_hash\":\"" << formatHash(result.replay.actualHash) << "\"";
+        }
+        out
+            << ",\"load_ms\":" << result.loadMilliseconds
+            << ",\"replay_ms\":" << result.replayMilliseconds << "}\n";
+    }
+    out << "{\"summary\":true,\"worlds\":" << results.size() << ",\"passed\":" << passed
+        << ",\"failed\":" << results.size() - passed << ",\"total_ms\":" << totalMilliseconds << "}" << std::endl;
+    return passed == results.size();
+}
@@ -1,64 +1,494 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
 #include "fileutils.hpp"
+#include "levelFormat.hpp"
 #include "block.hpp"
 #include "blockRegistry.hpp"
 #include "blockPos.hpp"
+#include "trace.hpp"
+#include "stateHash.hpp"
 
 using std::vector;
 
 class World {
+private:
+    // A square of CHUNK_SIZE x CHUNK_SIZE block ids, stored row by row
+    struct Chunk;
+    // The file a world was loaded from, together with the chunks decoded from it
+    struct ChunkSource;
+    // Block ids fit into one byte, so there are at most this many blocks in a world
+    static constexpr size_t MAX_PALETTE_SIZE = 256;
+
 public:
+    /**
+     * The blocks of a world at one point in time, taken with snapshot() and brought back with restore().
+     * A snapshot shares all chunks with the world, so taking one only copies the list of chunks
+     * and the amounts of each block, if they were counted (see getBlockAmount).
+     * A chunk is copied once the world changes it for the first time after the snapshot,
+     * so memory grows with the amount of chunks that changed, not with the amount of snapshots.
+     */
+    class Snapshot {
+    private:
+        friend class World;
+        vector<std::shared_ptr<Chunk>> chunks;
+        vector<const BlockId*> chunkData;
+        // The file chunks are decoded from. Snapshots can only be restored while the world is still reading from it
+        std::shared_ptr<ChunkSource> source;
+        unsigned int chunksWide = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int maxX = 0;
+        unsigned int maxY = 0;
+        uint64_t fieldHash = 0;
+        bool fieldHashKnown = false;
+        std::array<unsigned int, MAX_PALETTE_SIZE> blockAmounts;
+        bool blockAmountsKnown = false;
+    };
+
+    /**
+     * The cells that changed while it was recording (see record()), each with the block it had before,
+     * so that the changes can be taken back with revert(), e.g. to undo a move.
+     * Unlike a Snapshot, a log only grows with the amount of changed cells, not with the size of the world.
+     * Recording again clears the log but keeps its memory, so reusing logs does not allocate.
+     */
+    class ChangeLog {
+    private:
+        friend class World;
+        struct Change {
+            BlockPos pos;
+            BlockId id;
+        };
+        vector<Change> changes;
+        // The file the world read from while recording. Logs can only be reverted while the world is still reading from it
+        std::shared_ptr<ChunkSource> source;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int maxX = 0;
+        unsigned int maxY = 0;
+    };
+
     /**
      * Create a World object using the blocks defined in BlockRegistry.
      * 
      * @param blockRegistry The BlockRegistry to use.
      */
     World(BlockRegistry blockRegistry) {
-        this->blockRegistry = blockRegistry;
+        this->blockRegistry = std::make_shared<BlockRegistry>(blockRegistry);
+        // Enough room for the cells a typical move changes, so that moving around does not allocate
+        dirtyCells.reserve(INITIAL_CELL_CAPACITY);
+        activeCells.reserve(INITIAL_CELL_CAPACITY);
     }
     
     /**
      * Load the world from the given text file.
-     * - The character '|' is the player's starting position.
+     * - The character 'S' marks the player's starting position.
      * - The characters in the file are mapped to the corresponding blocks in the block registry.
      * - All other characters are kept as purely visual decoration blocks.
      * 
+     * The file is mapped into memory and only split into lines here, and every character it uses is registered as a block.
+     * The blocks of each chunk are decoded the first time the chunk is accessed, so huge worlds are ready to play right away.
+     * 
+     * Files ending in LEVEL_EXTENSION are precompiled levels and are loaded with loadFromBinaryFile instead.
+     * 
      * @param fileLocation The location of the file to load.
      */
     void loadFromFile(string fileLocation) {
-        field = {};
-        vector<string> file = readFileAsVector(fileLocation);
-        
-        for (unsigned int y = 0; y < file.size(); y++) {
-            for (unsigned int x = 0; x < file.at(y).size(); x++) {
-                setBlockAt(BlockPos(x, y), blockRegistry.getByEncoding(file.at(y).at(x)));
-                if (file.at(y).at(x) == 'S') startPos = BlockPos(x+3, y);
-                if (x > maxX) maxX = x;
+        if (fileLocation.ends_with(LEVEL_EXTENSION)) {
+            if (!loadFromBinaryFile(fileLocation)) cout << "Invalid level file: " << fileLocation << endl;
+            return;
+        }
+        reset();
+        source = std::make_shared<ChunkSource>();
+        source->file = std::make_shared<MappedFile>(fileLocation);
+        std::string_view content = source->file->getContent();
+        vector<size_t>& lineStarts = source->lineStarts;
+        vector<unsigned int>& lineLengths = source->lineLengths;
+
+        // Split the file into lines the same way std::getline would
+        unsigned int longestLine = 0;
+        for (size_t start = 0; start < content.size();) {
+            size_t end = content.find('\n', start);
+            if (end == std::string_view::npos) end = content.size();
+            lineStarts.push_back(start);
+            lineLengths.push_back(end - start);
+            longestLine = std::max(longestLine, static_cast<unsigned int>(end - start));
+            start = end + 1;
+        }
+        if (!lineStarts.empty()) title = string(content.substr(lineStarts[0], lineLengths[0]));
+
+        // Decorations are registered up front, so that decoding never changes the registry that copies of the world share
+        std::array<bool, 256> used = {};
+        for (char c : content) used[static_cast<unsigned char>(c)] = true;
+        for (size_t c = 0; c < used.size(); c++) {
+            if (used[c] && c != '\n') source->encodingIds[c] = ownBlockRegistry().getByEncoding(static_cast<char>(c)).getRawId();
+        }
+
+        resize(longestLine, lineStarts.size());
+        source->setChunkCount(chunksWide, chunks.size());
+        if (longestLine > 0) maxX = std::max(maxX, longestLine - 1);
+        if (!lineStarts.empty()) maxY = std::max(maxY, static_cast<unsigned int>(lineStarts.size() - 1));
+
+        // The last 'S' in the file is the starting position
+        size_t start = content.rfind('S');
+        if (start != std::string_view::npos) {
+            unsigned int y = std::upper_bound(lineStarts.begin(), lineStarts.end(), start) - lineStarts.begin() - 1;
+            startPos = BlockPos(start - lineStarts[y] + 3, y);
+        }
+    }
+
+    /**
+     * Load the world from a precompiled level, as written by saveToBinaryFile (see levelFormat.hpp for the format).
+     * 
+     * The file is mapped into memory and nothing but the header is read here.
+     * As long as the palette of the file matches the ids of the block registry, which is always the case for a new registry,
+     * the cells of each chunk are read straight from the mapped file until the chunk is changed for the first time.
+     * Otherwise each chunk is translated to the registry's ids on first access.
+     * Besides the header, only the block ids of the cells are checked once, so that a damaged file cannot refer to blocks outside of its palette.
+     * 
+     * @param fileLocation The location of the file to load.
+     * @return False if the file is not a valid level of the supported version, in which case the world is left empty.
+     */
+    bool loadFromBinaryFile(string fileLocation) {
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(fileLocation);
+        return loadFromBinary(file, file->getContent());
+    }
+
+    /**
+     * Load the world from a precompiled level that is part of a bigger file, like a level pack.
+     * Works the same as loadFromBinaryFile otherwise.
+     * 
+     * @param file The file containing the level. The world keeps it open for as long as it reads from it.
+     * @param level The part of the file's content that contains the level.
+     * @return False if the data is not a valid level of the supported version, in which case the world is left empty.
+     */
+    bool loadFromBinary(std::shared_ptr<MappedFile> file, std::string_view level) {
+        reset();
+        LevelReader reader = LevelReader(level);
+        if (reader.readBytes(LEVEL_MAGIC.size()) != LEVEL_MAGIC || reader.readUint16() != LEVEL_FORMAT_VERSION || reader.readUint8() != CHUNK_BITS) return false;
+        unsigned int fileWidth = reader.readUint32();
+        unsigned int fileHeight = reader.readUint32();
+        int startX = reader.readInt32();
+        int startY = reader.readInt32();
+        std::string_view fileTitle = reader.readBytes(reader.readUint16());
+        std::string_view palette = reader.readBytes(reader.readUint16());
+        size_t chunksHigh = (static_cast<size_t>(fileHeight) + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        unsigned int fileChunksWide = (fileWidth + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        std::shared_ptr<ChunkSource> loaded = std::make_shared<ChunkSource>();
+        vector<uint32_t>& fileChunks = loaded->fileChunks;
+        fileChunks.resize(fileChunksWide * chunksHigh);
+        for (uint32_t& chunk : fileChunks) chunk = reader.readUint32();
+        std::string_view cellData = reader.readRest();
+        if (!reader.isValid() || palette.size() > MAX_PALETTE_SIZE) return false;
+        for (uint32_t chunk : fileChunks) {
+            if (chunk == EMPTY_CHUNK) continue;
+            if ((static_cast<size_t>(chunk) + 1) * CHUNK_CELLS > cellData.size() || !hasValidIds(cellData.substr(static_cast<size_t>(chunk) * CHUNK_CELLS, CHUNK_CELLS), palette.size())) return false;
+        }
+
+        loaded->file = file;
+        loaded->cellData = cellData;
+        loaded->setChunkCount(fileChunksWide, fileChunks.size());
+        source = loaded;
+        title = string(fileTitle);
+        for (size_t id = 0; id < palette.size(); id++) {
+            source->paletteIds[id] = ownBlockRegistry().getByEncoding(palette[id]).getRawId();
+            if (source->paletteIds[id] != id) source->paletteMatches = false;
+        }
+        resize(fileWidth, fileHeight);
+        if (fileWidth > 0) maxX = std::max(maxX, fileWidth - 1);
+        if (fileHeight > 0) maxY = std::max(maxY, fileHeight - 1);
+        startPos = BlockPos(startX, startY);
+        return true;
+    }
+
+    /**
+     * Save the world as a precompiled level, which can be loaded with loadFromBinaryFile.
+     * The world is saved in its current state, including all changes made since it was loaded.
+     * 
+     * @param fileLocation The location of the file to write.
+     * @return False if the file could not be written.
+     */
+    bool saveToBinaryFile(string fileLocation) {
+        string level = saveToBinary();
+        std::ofstream file(fileLocation, std::ios::binary);
+        file.write(level.data(), level.size());
+        return file.good();
+    }
+
+    /**
+     * Encode the world as a precompiled level, the same way saveToBinaryFile does.
+     * 
+     * @return The content of the level file.
+     */
+    string saveToBinary() {
+        decodeAllChunks(); // The palette has to contain every block of the world
+
+        LevelWriter writer;
+        writer.writeBytes(LEVEL_MAGIC);
+        writer.writeUint16(LEVEL_FORMAT_VERSION);
+        writer.writeUint8(CHUNK_BITS);
+        writer.writeUint32(width);
+        writer.writeUint32(height);
+        writer.writeInt32(startPos.getX());
+        writer.writeInt32(startPos.getY());
+        std::string_view savedTitle = std::string_view(title).substr(0, UINT16_MAX);
+        writer.writeUint16(savedTitle.size());
+        writer.writeBytes(savedTitle);
+        writer.writeUint16(blockRegistry->getBlockCount());
+        for (size_t id = 0; id < blockRegistry->getBlockCount(); id++) writer.writeBytes(string(1, blockRegistry->getById(id).getEncoding()));
+
+        string cells;
+        for (const BlockId* data : chunkData) {
+            if (std::all_of(data, data + CHUNK_CELLS, [](BlockId id) { return id == 0; })) writer.writeUint32(EMPTY_CHUNK);
+            else {
+                writer.writeUint32(cells.size() / CHUNK_CELLS);
+                cells.append(reinterpret_cast<const char*>(data), CHUNK_CELLS);
+            }
+        }
+        writer.writeBytes(cells);
+        return writer.getData();
+    }
+
+    /**
+     * Take a snapshot of the blocks of the world, which can be restored later on (e.g. to undo a move).
+     * 
+     * @return The current state of the world.
+     */
+    Snapshot snapshot() {
+        Snapshot snapshot;
+        snapshot.chunks = chunks;
+        snapshot.chunkData = chunkData;
+        snapshot.source = source;
+        snapshot.chunksWide = chunksWide;
+        snapshot.width = width;
+        snapshot.height = height;
+        snapshot.maxX = maxX;
+        snapshot.maxY = maxY;
+        snapshot.fieldHash = fieldHash;
+        snapshot.fieldHashKnown = fieldHashKnown;
+        if (blockAmountsKnown) snapshot.blockAmounts = blockAmounts;
+        snapshot.blockAmountsKnown = blockAmountsKnown;
+        return snapshot;
+    }
+
+    /**
+     * Bring the blocks of the world back to the state of the given snapshot.
+     * All cells that change are marked as dirty, so the next frame shows the restored world.
+     * 
+     * @param snapshot A snapshot taken from this world since the current level was loaded.
+     * @return False if the snapshot belongs to another level, in which case the world stays unchanged.
+     */
+    bool restore(const Snapshot& snapshot) {
+        if (snapshot.source != source) return false;
+        recording.log = nullptr;
+        bool resized = snapshot.width != width || snapshot.height != height;
+        if (resized) resize(snapshot.width, snapshot.height);
+        for (size_t chunk = 0; chunk < chunkData.size(); chunk++) {
+            const BlockId* cells = snapshot.chunkData[chunk];
+            // The snapshot did not decode this chunk, so it still has the blocks of the source file, which the world decoded since
+            if (cells == nullptr && chunkData[chunk] != nullptr) cells = sourceCells(chunk);
+            if (chunkData[chunk] == cells) continue;
+            if (!resized) markChangedCells(chunk, cells);
+            // A chunk only this world uses gets the blocks of the snapshot copied into it, so that changing it again does not copy it
+            if (chunks[chunk] && chunks[chunk].use_count() == 1 && cells != nullptr) {
+                std::memcpy(chunks[chunk]->cells.data(), cells, CHUNK_CELLS);
+                continue;
             }
-            if (y > maxY) maxY = y;
+            chunks[chunk] = snapshot.chunks[chunk];
+            chunkData[chunk] = cells;
+        }
+        chunksWide = snapshot.chunksWide;
+        width = snapshot.width;
+        height = snapshot.height;
+        maxX = snapshot.maxX;
+        maxY = snapshot.maxY;
+        fieldHash = snapshot.fieldHash;
+        fieldHashKnown = snapshot.fieldHashKnown;
+        if (snapshot.blockAmountsKnown) blockAmounts = snapshot.blockAmounts;
+        blockAmountsKnown = snapshot.blockAmountsKnown;
+        activeCells.clear();
+        if (resized) {
+            // The renderer draws everything again anyway, as the size of the world changed
+            dirtyCells.clear();
+            markDirty(BlockPos(0, 0));
+        }
+        return true;
+    }
+
+    /**
+     * Record every cell that changes from now on in the given log, together with the block it had before.
+     * Whatever the log contained is cleared. Only one log records at a time, copies of the world do not record.
+     *
+     * @param log The log to record in, or nullptr to stop recording. Has to stay alive until recording stops.
+     */
+    void record(ChangeLog* log) {
+        recording.log = log;
+        if (log == nullptr) return;
+        log->changes.clear();
+        log->source = source;
+        log->width = width;
+        log->height = height;
+        log->maxX = maxX;
+        log->maxY = maxY;
+    }
+
+    /**
+     * Take back the changes in the given log, latest first, which stops recording.
+     * All cells that change are marked as dirty, so the next frame shows the world as it was before.
+     *
+     * @param log A log recorded in this world, with no changes made after the ones it contains.
+     * @return False if the log belongs to another level, in which case the world stays unchanged.
+     */
+    bool revert(const ChangeLog& log) {
+        if (log.source != source) return false;
+        recording.log = nullptr;
+        for (auto change = log.changes.rbegin(); change != log.changes.rend(); change++) {
+            writeCell(change->pos, change->id);
+            markDirty(change->pos);
+        }
+        maxX = log.maxX;
+        maxY = log.maxY;
+        activeCells.clear();
+        if (log.width != width || log.height != height) {
+            resize(log.width, log.height);
+            // The renderer draws everything again anyway, as the size of the world changed
+            dirtyCells.clear();
+            markDirty(BlockPos(0, 0));
+        }
+        return true;
+    }
+
+    /**
+     * Get a hash of every block in the world (see stateHash.hpp).
+     * The first call decodes and hashes the whole world. From then on, the hash is updated with every changed cell,
+     * so further calls cost nothing.
+     * 
+     * @return The hash of all blocks and their positions.
+     */
+    uint64_t getFieldHash() {
+        if (fieldHashKnown) return fieldHash;
+        decodeAllChunks();
+        fieldHash = 0;
+        for (size_t chunk = 0; chunk < chunkData.size(); chunk++) {
+            if (chunkData[chunk] == AIR_CHUNK.cells.data()) continue;
+            unsigned int chunkX = (chunk % chunksWide) << CHUNK_BITS;
+            unsigned int chunkY = (chunk / chunksWide) << CHUNK_BITS;
+            for (size_t i = 0; i < CHUNK_CELLS; i++)
+                fieldHash ^= cellHash(BlockPos(chunkX + (i & (CHUNK_SIZE - 1)), chunkY + (i >> CHUNK_BITS)), chunkData[chunk][i]);
+        }
+        fieldHashKnown = true;
+        return fieldHash;
+    }
+
+    /**
+     * Count how many cells contain the given block.
+     * The first call decodes and counts the whole world. From then on, the amounts are updated with every changed cell,
+     * and snapshots taken afterwards restore them as well.
+     * 
+     * @param block The block to count. AIR is not counted, as the world is filled up with it when it grows.
+     * @return The amount of cells containing that block.
+     */
+    unsigned int getBlockAmount(const Block& block) {
+        if (!blockAmountsKnown) {
+            decodeAllChunks();
+            blockAmounts.fill(0);
+            for (const BlockId* data : chunkData)
+                for (size_t i = 0; i < CHUNK_CELLS; i++) blockAmounts[data[i]]++;
+            blockAmountsKnown = true;
+        }
+        return block.getRawId() == 0 ? 0 : blockAmounts[block.getRawId()];
+    }
+
+    /**
+     * Decode every chunk of the world right away, instead of on first access.
+     * Useful to prepare a world on another thread, so that playing it never has to wait for the source file (see LevelPack::preload).
+     */
+    void decodeAllChunks() {
+        for (size_t chunk = 0; chunk < chunkData.size(); chunk++) {
+            if (chunkData[chunk] == nullptr) decodeChunk(chunk);
         }
     }
+
     /**
      * Sets the block at the given position in the world.
      * 
      * In case the position is outside the current bounds of the world, the world will be automatically be expanded.
-     * If the position is negative, an error will be logged.
+     * If the position is negative, an error will be logged and the world stays unchanged.
+     * Afterwards, physics are applied to the changed position and the block above it (see settle).
      * 
      * @param pos The position to set the block at.
      * @param block The block to set at that position.
      */
-    void setBlockAt(BlockPos pos, Block block) {
-        if (pos.isNegative()) cout << "Tried to set block at negative position: (x: " << pos.getX() << ", y:" << pos.getY() << ")" << endl;
-        while (field.size() <= pos.getUnsignedY()) field.push_back({});
-        while (field[pos.getUnsignedY()].size() <= pos.getUnsignedX()) field[pos.getUnsignedY()].push_back(blockRegistry.AIR);
+    void setBlockAt(BlockPos pos, const Block& block) {
+        Tracer::count(TraceCounter::SET_BLOCK);
+        if (!placeBlockAt(pos, block)) return;
+        scheduleUpdate(pos); // The block itself might have to fall
+        scheduleUpdate(pos.add(0, -1)); // The block above might have lost its support
+        settle();
+    }
+
+    /**
+     * Marks the given position for the next physics update in settle.
+     * 
+     * @param pos The position that might need to move.
+     */
+    void scheduleUpdate(BlockPos pos) {
+        if (containsPos(pos)) activeCells.push_back(pos);
+    }
+
+    /**
+     * Applies gravity to all positions that were scheduled for an update, until nothing moves anymore.
+     * 
+     * A block with gravity falls straight down until it lands on anything that is not AIR or reaches the bottom of the world.
+     * Whenever a block falls, the position above it is scheduled as well, so stacked blocks fall down one after another.
+     * Only scheduled positions are checked, so the cost depends on the amount of moving blocks, not on the size of the world.
+     */
+    void settle() {
+        if (settling) return; // Blocks placed while settling are handled by the loop that is already running
+        settling = true;
+        for (size_t next = 0; next < activeCells.size(); next++) {
+            BlockPos pos = activeCells[next];
+            const Block& block = getBlockAt(pos);
+            if (!block.getSettings().hasGravity()) continue;
+
+            BlockPos landing = pos;
+            while (containsPos(landing.add(0, 1)) && getBlockAt(landing.add(0, 1)) == blockRegistry->AIR) landing = landing.add(0, 1);
+            if (landing.getY() == pos.getY()) continue;
+
+            placeBlockAt(landing, block);
+            placeBlockAt(pos, blockRegistry->AIR);
+            scheduleUpdate(pos.add(0, -1));
+        }
+        activeCells.clear();
+        settling = false;
+    }
+
+    /**
+     * Places the block at the given position in the world, without letting it fall down.
+     * Behaves like setBlockAt otherwise.
+     * 
+     * @param pos The position to place the block at.
+     * @param block The block to place at that position.
+     * @return False if the position was negative and nothing was placed, true otherwise.
+     */
+    bool placeBlockAt(BlockPos pos, const Block& block) {
+        if (pos.isNegative()) {
+            cout << "Tried to set block at negative position: (x: " << pos.getX() << ", y:" << pos.getY() << ")" << endl;
+            return false;
+        }
+        if (pos.getUnsignedX() >= width || pos.getUnsignedY() >= height) 
+            resize(std::max(width, pos.getUnsignedX() + 1), std::max(height, pos.getUnsignedY() + 1));
 
-        field[pos.getUnsignedY()][pos.getX()] = block;
-        if (block.getSettings().hasGravity() && containsPos(pos.add(0, 1)) && getBlockAt(pos.add(0, 1)) == blockRegistry.AIR) {
-            setBlockAt(pos.add(0, 1), block);
-            setBlockAt(pos, blockRegistry.AIR);
+        if (readCell(pos) != block.getRawId()) {
+            writeCell(pos, block.getRawId());
+            markDirty(pos);
         }
+        return true;
     }
 
     /**
@@ -69,12 +499,51 @@ public:
      * @param pos The position to get the block at.
      * @return The block at that position.
      */
-    Block& getBlockAt(BlockPos pos) {
-        if (pos.getUnsignedY() < field.size() && pos.getUnsignedX() < field[pos.getUnsignedY()].size()) {
-            return field[pos.getY()][pos.getX()];
+    const Block& getBlockAt(BlockPos pos) {
+        Tracer::count(TraceCounter::GET_BLOCK);
+        if (pos.getUnsignedY() < height && pos.getUnsignedX() < width) {
+            return blockRegistry->getById(readCell(pos));
         }
         //cout << "Out of bounds: " << pos.getX() << ", " << pos.getY() << endl;
-        return blockRegistry.AIR;
+        return blockRegistry->AIR;
+    }
+
+    /**
+     * Get the settings of the block at the given position in the world.
+     * Cheaper than getBlockAt(pos).getSettings(), as only the block id and the registry's settings table are read.
+     * 
+     * @param pos The position to get the settings at.
+     * @return The settings of the block at that position, or those of AIR if the position is outside of the world.
+     */
+    BlockSettings getSettingsAt(BlockPos pos) {
+        if (pos.getUnsignedY() < height && pos.getUnsignedX() < width) {
+            return blockRegistry->getSettingsById(readCell(pos));
+        }
+        return blockRegistry->AIR.getSettings();
+    }
+
+    /**
+     * Checks whether any block in a horizontal span of the world has one of the given properties.
+     * Useful for physics queries, like checking if a row contains anything lethal or solid.
+     * 
+     * @param y The row to check.
+     * @param fromX The first column of the span (inclusive).
+     * @param toX The last column of the span (inclusive).
+     * @param flags One or more BlockSettings::Flag values combined with |.
+     * @return True if at least one block in the span has any of the given flags, false if the span is empty (fromX > toX).
+     */
+    bool anyInRow(int y, int fromX, int toX, uint16_t flags) {
+        if (fromX > toX) return false;
+        // Cells outside of the world are AIR
+        bool outsideMatches = blockRegistry->AIR.getSettings().has(flags);
+        if (y < 0 || static_cast<unsigned int>(y) >= height) return outsideMatches;
+        if (outsideMatches && (fromX < 0 || static_cast<unsigned int>(toX) >= width)) return true;
+
+        unsigned int end = std::min(static_cast<unsigned int>(std::max(toX + 1, 0)), width);
+        for (unsigned int x = std::max(fromX, 0); x < end; x++) {
+            if (blockRegistry->getSettingsById(readCell(BlockPos(x, y))).has(flags)) return true;
+        }
+        return false;
     }
 
     /**
@@ -84,14 +553,44 @@ public:
      * @return True if the position is non-negative and within the current bounds of the world, false otherwise.
      */
     bool containsPos(BlockPos pos) {
-        return !pos.isNegative() && pos.getUnsignedY() < field.size();
+        return !pos.isNegative() && pos.getUnsignedY() < height;
     }
-    
+
+    /**
+     * Marks the cell at the given position as changed, so that it is drawn again in the next frame.
+     * Positions outside of the world are ignored.
+     * 
+     * @param pos The position that needs to be redrawn.
+     */
+    void markDirty(BlockPos pos) {
+        if (pos.getUnsignedY() < height && pos.getUnsignedX() < width) dirtyCells.push_back(pos);
+    }
+
+    /**
+     * Get all positions that were marked as changed since the last call to clearDirtyCells.
+     * The list may contain the same position multiple times.
+     * 
+     * @return The changed positions.
+     */
+    vector<BlockPos>& getDirtyCells() {
+        return dirtyCells;
+    }
+
+    /**
+     * Forget all changed positions, after they have been drawn.
+     */
+    void clearDirtyCells() {
+        dirtyCells.clear();
+    }
+
     /**
-     * @return The current state of the world as a 2D vector of blocks.
+     * Get the title of the world.
+     * For text files this is the first line, which is also part of the world itself.
+     * 
+     * @return The title, or an empty string if the world has none.
      */
-    vector<vector<Block>> getFieldState() {
-        return field;
+    const string& getTitle() {
+        return title;
     }
 
     /**
@@ -99,8 +598,8 @@ public:
      * 
      * @return The block registry containing all registered blocks.
      */
-    BlockRegistry getBlockRegistry() {
-        return blockRegistry;
+    const BlockRegistry& getBlockRegistry() {
+        return *blockRegistry;
     }
     
     /**
@@ -120,7 +619,27 @@ public:
     unsigned int getMaxY() {
         return maxY;
     }
-    
+
+    /**
+     * Get the amount of columns of the world. Unlike getMaxX, this includes columns that were added while playing,
+     * when a block was placed outside of the world.
+     *
+     * @return The width of the world.
+     */
+    unsigned int getWidth() {
+        return width;
+    }
+
+    /**
+     * Get the amount of rows of the world. Unlike getMaxY, this includes rows that were added while playing,
+     * like the row a block falls into from the bottom of the world (see tryBlockGravity).
+     *
+     * @return The height of the world.
+     */
+    unsigned int getHeight() {
+        return height;
+    }
+
     /**
      * Get the starting position of the player in the world.
      * 
@@ -131,9 +650,296 @@ public:
         return startPos;
     }
 private:
-    BlockRegistry blockRegistry;
-    vector<vector<Block>> field;
+    static constexpr unsigned int CHUNK_BITS = 5;
+    static constexpr unsigned int CHUNK_SIZE = 1 << CHUNK_BITS;
+    static constexpr size_t CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+    static constexpr size_t INITIAL_CELL_CAPACITY = 64;
+    struct Chunk {
+        std::array<BlockId, CHUNK_CELLS> cells;
+    };
+
+    /**
+     * Shared by all copies of a world and all snapshots taken from them, so that every chunk is only decoded once,
+     * by whichever copy accesses it first. Like any other chunk, a decoded chunk is only copied once a world changes it.
+     * Chunks can be decoded from several threads at once.
+     */
+    struct ChunkSource {
+        std::shared_ptr<MappedFile> file;
+        // Where each line starts in a text file, and how long it is
+        vector<size_t> lineStarts;
+        vector<unsigned int> lineLengths;
+        // Maps each character of a text file to the id of its block
+        std::array<BlockId, 256> encodingIds = {};
+        // For precompiled levels: the index of each chunk's cells in cellData, as stored in the file
+        vector<uint32_t> fileChunks;
+        std::string_view cellData;
+        // Maps the block ids used in the level file to the ids of the block registry
+        std::array<BlockId, MAX_PALETTE_SIZE> paletteIds;
+        bool paletteMatches = true;
+        // The size of the world in chunks when it was loaded, as the world might grow later on
+        unsigned int chunksWide = 0;
+        // The cells of each chunk of the file, stored row by row, or nullptr if no copy of the world decoded it yet
+        vector<std::atomic<const BlockId*>> decoded;
+        // Chunks whose cells had to be created while decoding, as they are not stored in the file as they are
+        vector<std::unique_ptr<Chunk>> owned;
+        // Guards decoding, so that every chunk is decoded only once
+        std::mutex decodeMutex;
+
+        void setChunkCount(unsigned int wide, size_t count) {
+            chunksWide = wide;
+            decoded = vector<std::atomic<const BlockId*>>(count);
+        }
+    };
+
+    // Shared between copies of the world, see ownBlockRegistry
+    std::shared_ptr<BlockRegistry> blockRegistry;
+    // Shared by all chunks that only contain AIR, so that those take up no memory of their own
+    static inline const Chunk AIR_CHUNK = {};
+    // The world is split into chunks, stored row by row. Chunks that only contain AIR are not stored at all (nullptr).
+    // Chunks are shared between copies of the world and only copied once one of the copies changes them.
+    vector<std::shared_ptr<Chunk>> chunks;
+    // Where the blocks of each chunk can be read from: the stored chunk, AIR_CHUNK, the mapped level file, or nullptr if it was not decoded yet
+    vector<const BlockId*> chunkData;
+    unsigned int chunksWide = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    // The file this world was loaded from, used to decode chunks on first access
+    std::shared_ptr<ChunkSource> source;
+    string title;
+    // Hash of all cells, only kept up to date once it was requested with getFieldHash
+    uint64_t fieldHash = 0;
+    bool fieldHashKnown = false;
+    // Amount of cells per block id, only kept up to date once requested with getBlockAmount
+    std::array<unsigned int, MAX_PALETTE_SIZE> blockAmounts;
+    bool blockAmountsKnown = false;
+    // Cells that changed since the last frame was drawn
+    vector<BlockPos> dirtyCells;
+    // Cells that might have to move in the next physics update
+    vector<BlockPos> activeCells;
+    bool settling = false;
+    /**
+     * The log that changed cells are recorded in (see record()), which is not taken over by copies of the world.
+     */
+    struct Recording {
+        ChangeLog* log = nullptr;
+
+        Recording() {}
+        Recording(const Recording&) {}
+        Recording& operator=(const Recording&) {
+            log = nullptr;
+            return *this;
+        }
+    } recording;
     unsigned int maxX = 0;
     unsigned int maxY = 0;
     BlockPos startPos = BlockPos(0, 0);
-};
\ No newline at end of file
+
+    /**
+     * Get the index of the chunk that contains the given position.
+     * The position has to be within the current bounds of the world.
+     */
+    size_t chunkIndex(BlockPos pos) {
+        return static_cast<size_t>(pos.getUnsignedY() >> CHUNK_BITS) * chunksWide + (pos.getUnsignedX() >> CHUNK_BITS);
+    }
+
+    /**
+     * Get the position of the given block inside of its chunk.
+     */
+    static size_t cellIndex(BlockPos pos) {
+        return ((pos.getUnsignedY() & (CHUNK_SIZE - 1)) << CHUNK_BITS) | (pos.getUnsignedX() & (CHUNK_SIZE - 1));
+    }
+
+    /**
+     * Get the block registry to register new blocks in, e.g. decorations while loading.
+     * Copies of the world share their registry, so it is copied first if another copy still uses it.
+     */
+    BlockRegistry& ownBlockRegistry() {
+        if (blockRegistry.use_count() > 1) blockRegistry = std::make_shared<BlockRegistry>(*blockRegistry);
+        return *blockRegistry;
+    }
+
+    /**
+     * Get the id of the block at the given position, decoding its chunk if needed.
+     * The position has to be within the current bounds of the world.
+     */
+    BlockId readCell(BlockPos pos) {
+        size_t chunk = chunkIndex(pos);
+        if (chunkData[chunk] == nullptr) decodeChunk(chunk);
+        return chunkData[chunk][cellIndex(pos)];
+    }
+
+    /**
+     * Set the id of the block at the given position, creating or copying its chunk if needed.
+     * The position has to be within the current bounds of the world.
+     */
+    void writeCell(BlockPos pos, BlockId id) {
+        size_t chunk = chunkIndex(pos);
+        if (chunkData[chunk] == nullptr) decodeChunk(chunk);
+        if (fieldHashKnown) fieldHash ^= cellHash(pos, chunkData[chunk][cellIndex(pos)]) ^ cellHash(pos, id);
+        if (blockAmountsKnown) {
+            blockAmounts[chunkData[chunk][cellIndex(pos)]]--;
+            blockAmounts[id]++;
+        }
+        if (recording.log != nullptr) recording.log->changes.push_back({pos, chunkData[chunk][cellIndex(pos)]});
+        std::shared_ptr<Chunk>& stored = chunks[chunk];
+        if (!stored || stored.use_count() > 1) { // Only AIR, still in the level file, or shared with another copy of the world
+            if (!stored && id == 0 && chunkData[chunk] == AIR_CHUNK.cells.data()) return; // Still only AIR
+            std::shared_ptr<Chunk> copy = std::make_shared<Chunk>();
+            std::memcpy(copy->cells.data(), chunkData[chunk], CHUNK_CELLS);
+            stored = copy;
+        }
+        stored->cells[cellIndex(pos)] = id;
+        chunkData[chunk] = stored->cells.data();
+    }
+
+    /**
+     * Get the hash of a cell containing the block with the given id. Cells with AIR do not count.
+     */
+    uint64_t cellHash(BlockPos pos, BlockId id) {
+        return id == 0 ? 0 : hashCell(pos, blockRegistry->getById(id).getEncoding());
+    }
+
+    /**
+     * Mark every cell of the given chunk that differs from the given cells as dirty.
+     * 
+     * @param chunk The index of the chunk.
+     * @param cells The cells to compare with, or nullptr if they still have to be decoded from the source file.
+     */
+    void markChangedCells(size_t chunk, const BlockId* cells) {
+        if (chunkData[chunk] == nullptr) decodeChunk(chunk);
+        unsigned int chunkX = (chunk % chunksWide) << CHUNK_BITS;
+        unsigned int chunkY = (chunk / chunksWide) << CHUNK_BITS;
+        for (size_t i = 0; i < CHUNK_CELLS; i++) {
+            if (cells == nullptr || cells[i] != chunkData[chunk][i]) markDirty(BlockPos(chunkX + (i & (CHUNK_SIZE - 1)), chunkY + (i >> CHUNK_BITS)));
+        }
+    }
+
+    /**
+     * Decode the blocks of the given chunk from the source file.
+     * Chunks that only contain AIR stay empty.
+     */
+    void decodeChunk(size_t chunk) {
+        chunkData[chunk] = sourceCells(chunk);
+    }
+
+    /**
+     * Get the blocks of the given chunk as they are in the source file, decoding them if no copy of the world did so yet.
+     * Chunks outside of the file, e.g. after the world grew, only contain AIR.
+     */
+    const BlockId* sourceCells(size_t chunk) {
+        unsigned int fileX = chunk % chunksWide;
+        size_t index = chunk / chunksWide * (source ? source->chunksWide : 0) + fileX;
+        if (!source || fileX >= source->chunksWide || index >= source->decoded.size()) return AIR_CHUNK.cells.data();
+
+        const BlockId* cells = source->decoded[index].load(std::memory_order_acquire);
+        if (cells != nullptr) return cells;
+        std::lock_guard lock(source->decodeMutex);
+        cells = source->decoded[index].load(std::memory_order_relaxed);
+        if (cells == nullptr) {
+            if (source->fileChunks.empty()) cells = decodeTextChunk(*source, fileX << CHUNK_BITS, (index / source->chunksWide) << CHUNK_BITS);
+            else cells = decodeLevelChunk(*source, source->fileChunks[index]);
+            source->decoded[index].store(cells, std::memory_order_release);
+        }
+        return cells;
+    }
+
+    /**
+     * Decode the chunk of a text file that starts at the given position.
+     *
+     * @return The decoded blocks, or those of AIR_CHUNK if the chunk only contains AIR.
+     */
+    static const BlockId* decodeTextChunk(ChunkSource& source, unsigned int chunkX, unsigned int chunkY) {
+        std::string_view content = source.file->getContent();
+        std::unique_ptr<Chunk> decoded = std::make_unique<Chunk>();
+        bool empty = true;
+        for (unsigned int y = 0; y < CHUNK_SIZE; y++) {
+            unsigned int lineLength = chunkY + y < source.lineStarts.size() ? source.lineLengths[chunkY + y] : 0;
+            for (unsigned int x = 0; x < CHUNK_SIZE; x++) {
+                BlockId id = 0;
+                if (chunkX + x < lineLength) id = source.encodingIds[static_cast<unsigned char>(content[source.lineStarts[chunkY + y] + chunkX + x])];
+                decoded->cells[(y << CHUNK_BITS) | x] = id;
+                if (id != 0) empty = false;
+            }
+        }
+        if (empty) return AIR_CHUNK.cells.data();
+        source.owned.push_back(std::move(decoded));
+        return source.owned.back()->cells.data();
+    }
+
+    /**
+     * Get the cells of a chunk of a precompiled level, straight from the mapped file if its palette matches the block registry.
+     *
+     * @param stored The index of the chunk's cells in the file's cell data, or EMPTY_CHUNK.
+     * @return The blocks of the chunk.
+     */
+    static const BlockId* decodeLevelChunk(ChunkSource& source, uint32_t stored) {
+        if (stored == EMPTY_CHUNK) return AIR_CHUNK.cells.data();
+
+        const BlockId* cells = reinterpret_cast<const BlockId*>(source.cellData.data()) + static_cast<size_t>(stored) * CHUNK_CELLS;
+        if (source.paletteMatches) return cells;
+        std::unique_ptr<Chunk> translated = std::make_unique<Chunk>();
+        for (size_t i = 0; i < CHUNK_CELLS; i++) translated->cells[i] = source.paletteIds[cells[i]];
+        source.owned.push_back(std::move(translated));
+        return source.owned.back()->cells.data();
+    }
+
+    /**
+     * Check that the given cells of a level file only use ids of its palette.
+     * 
+     * @param cells The block ids of a stored chunk.
+     * @param paletteSize The amount of blocks in the palette of the file.
+     * @return False if any id is not in the palette.
+     */
+    static bool hasValidIds(std::string_view cells, size_t paletteSize) {
+        const BlockId* ids = reinterpret_cast<const BlockId*>(cells.data());
+        BlockId highest = 0;
+        for (size_t i = 0; i < cells.size(); i++) highest = std::max(highest, ids[i]);
+        return highest < paletteSize;
+    }
+
+    /**
+     * Remove everything that was loaded before, so that another world can be loaded into this object.
+     */
+    void reset() {
+        chunks = {};
+        chunkData = {};
+        chunksWide = 0;
+        width = 0;
+        height = 0;
+        source = nullptr;
+        title = "";
+        fieldHashKnown = false;
+        blockAmountsKnown = false;
+        dirtyCells.clear(); // Keeps its capacity, in case the World object is reused for another level
+        recording.log = nullptr;
+    }
+
+    /**
+     * Resize the world to the given dimensions, keeping all existing blocks in place.
+     * New cells are AIR.
+     */
+    void resize(unsigned int newWidth, unsigned int newHeight) {
+        unsigned int newChunksWide = (newWidth + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        unsigned int newChunksHigh = (newHeight + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        if (newChunksWide == chunksWide) {
+            chunks.resize(static_cast<size_t>(newChunksWide) * newChunksHigh);
+            chunkData.resize(chunks.size(), nullptr);
+        }
+        else {
+            unsigned int chunksHigh = chunksWide == 0 ? 0 : chunks.size() / chunksWide;
+            vector<std::shared_ptr<Chunk>> resized(static_cast<size_t>(newChunksWide) * newChunksHigh);
+            vector<const BlockId*> resizedData(resized.size(), nullptr);
+            for (unsigned int y = 0; y < std::min(chunksHigh, newChunksHigh); y++) {
+                for (unsigned int x = 0; x < std::min(chunksWide, newChunksWide); x++) {
+                    resized[static_cast<size_t>(y) * newChunksWide + x] = std::move(chunks[static_cast<size_t>(y) * chunksWide + x]);
+                    resizedData[static_cast<size_t>(y) * newChunksWide + x] = chunkData[static_cast<size_t>(y) * chunksWide + x];
+                }
+            }
+            chunks = std::move(resized);
+            chunkData = std::move(resizedData);
+        }
+        chunksWide = newChunksWide;
+        width = newWidth;
+        height = newHeight;
+    }
+};